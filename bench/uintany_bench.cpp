@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Benchmark for serial_traits<uintany>.
+
+  Compares the encoder, the decoder and decode_n with the loop based versions they replaced, on random
+  widths, small skewed values (mostly single byte) and maximum width values. Build it with and without
+  -mavx2 -mbmi2 to compare the SIMD and scalar paths. Prints nanoseconds per value.
+*/
+
+#include "rpnx/serial_traits.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+  /*
+    The loops serial_traits<uintany> used before. The encoder's shift is clamped so that 10 byte
+    values are defined.
+  */
+  uint8_t * old_serialize(uintmax_t base, uint8_t * out)
+  {
+    uintmax_t bytecount = 1;
+    uintmax_t max = (uintmax_t(1) << 7) - 1;
+    while (base > max)
+      {
+        bytecount++;
+        base -= max + 1;
+        max = 7*bytecount >= 64 ? UINTMAX_MAX : (uintmax_t(1) << (7*bytecount)) - 1;
+      }
+    for (uintmax_t i = 0; i < bytecount; i++)
+      {
+        uint8_t val = base & 0x7f;
+        if (i != bytecount - 1) val |= 0x80;
+        *out++ = val;
+        base >>= 7;
+      }
+    return out;
+  }
+
+  uint8_t const * old_deserialize(uintmax_t & n, uint8_t const * in)
+  {
+    n = 0;
+    uintmax_t n2 = 0;
+    while (true)
+      {
+        uint8_t a = *in++;
+        n += uintmax_t(a & 0x7f) << (n2*7);
+        if (!(a & 0x80)) break;
+        n2++;
+      }
+    for (uintmax_t i = 1; i <= n2; i++)
+      {
+        n += uintmax_t(1) << (i*7);
+      }
+    return in;
+  }
+
+  template <typename F>
+  double time_per_value(size_t count, F f)
+  {
+    double best = 1e30;
+    for (int rep = 0; rep < 15; rep++)
+      {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        if (took.count() < best) best = took.count();
+      }
+    return best/count;
+  }
+
+  void run(char const * name, std::vector<uintmax_t> const & values)
+  {
+    using traits = rpnx::serial_traits<rpnx::uintany>;
+    size_t count = values.size();
+    std::vector<uint8_t> buf(count*10);
+    std::vector<uintmax_t> out(count);
+    uint8_t * end = buf.data();
+    volatile uintmax_t sink = 0;
+
+    double old_enc = time_per_value(count, [&] {
+        uint8_t * p = buf.data();
+        for (uintmax_t n : values) p = old_serialize(n, p);
+        end = p;
+      });
+    double new_enc = time_per_value(count, [&] {
+        uint8_t * p = buf.data();
+        for (uintmax_t n : values) p = traits::serialize(n, p);
+        if (p != end) std::abort();
+      });
+    double old_dec = time_per_value(count, [&] {
+        uint8_t const * p = buf.data();
+        for (size_t i = 0; i < count; i++) p = old_deserialize(out[i], p);
+        sink = sink + out[count - 1];
+      });
+    double new_dec = time_per_value(count, [&] {
+        uint8_t const * p = buf.data();
+        for (size_t i = 0; i < count; i++) p = traits::deserialize(out[i], p);
+        sink = sink + out[count - 1];
+      });
+    double checked_dec = time_per_value(count, [&] {
+        uint8_t const * p = buf.data();
+        for (size_t i = 0; i < count; i++) p = traits::deserialize(out[i], p, static_cast<uint8_t const *>(end));
+        sink = sink + out[count - 1];
+      });
+    double bulk_dec = time_per_value(count, [&] {
+        traits::decode_n(buf.data(), count, out.data());
+        sink = sink + out[count - 1];
+      });
+    for (size_t i = 0; i < count; i++)
+      {
+        if (out[i] != values[i]) std::abort();
+      }
+
+    std::printf("%-12s %6.2f B/value  encode %6.2f -> %6.2f ns  decode %6.2f -> %6.2f ns  checked %6.2f ns  decode_n %6.2f ns\n",
+                name, double(end - buf.data())/count, old_enc, new_enc, old_dec, new_dec, checked_dec, bulk_dec);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::mt19937_64 rng(1);
+  std::vector<uintmax_t> random(count), small(count), wide(count);
+  for (size_t i = 0; i < count; i++)
+    {
+      random[i] = rng() >> (rng() % 64);
+      small[i] = rng() % 16 == 0 ? rng() % 100000 : rng() % 128;
+      wide[i] = rng() | (uintmax_t(1) << 63);
+    }
+
+#if defined(__AVX2__)
+  std::puts("uintany benchmark (AVX2)");
+#elif defined(__SSE4_1__)
+  std::puts("uintany benchmark (SSE4.1)");
+#else
+  std::puts("uintany benchmark (scalar)");
+#endif
+  run("random", random);
+  run("small", small);
+  run("max width", wide);
+  return 0;
+}
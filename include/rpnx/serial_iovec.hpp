@@ -0,0 +1,248 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RPNX_SERIAL_IOVEC_HH
+#define RPNX_SERIAL_IOVEC_HH
+
+#if defined(__has_include)
+#if __has_include("serial_traits.hpp")
+#include "serial_traits.hpp"
+#else
+#include "serial_traits"
+#endif
+#else
+#include "serial_traits.hpp"
+#endif
+
+#include <vector>
+#include <system_error>
+#include <cerrno>
+#include <climits>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace rpnx
+{
+  /*
+    Scatter/gather output sink.
+
+    Small fields are written to a scratch buffer, while contiguous runs of bytes taken from the object
+    being serialized (byte vectors and strings, vectors of integers on little endian hosts, views) that
+    are at least threshold bytes long are recorded as references to the object's own memory. iovecs()
+    then describes the whole encoding, and write_all()/send_all() hand it to writev/sendmsg, so large
+    payloads are never copied. The serialized object must not change or be destroyed until the output
+    has been written.
+  */
+  class iovec_output
+  {
+    struct segment
+    {
+      // data is null for bytes in the scratch buffer, which start at offset.
+      uint8_t const * data;
+      size_t offset;
+      size_t size;
+    };
+
+    std::vector<uint8_t> m_scratch;
+    std::vector<segment> m_segments;
+    std::vector<struct iovec> m_iov;
+    size_t m_threshold;
+    size_t m_size;
+
+    template <typename F>
+    void write_loop(char const * what, F && f)
+    {
+      std::vector<struct iovec> const & iov = iovecs();
+      std::vector<struct iovec> rest(iov.begin(), iov.end());
+      size_t i = 0;
+      while (i != rest.size())
+        {
+          size_t count = rest.size() - i;
+          if (count > size_t(IOV_MAX)) count = IOV_MAX;
+          ssize_t r = f(rest.data() + i, count);
+          if (r < 0)
+            {
+              if (errno == EINTR) continue;
+              throw std::system_error(errno, std::generic_category(), what);
+            }
+          size_t done = size_t(r);
+          while (i != rest.size() && done >= rest[i].iov_len)
+            {
+              done -= rest[i].iov_len;
+              i++;
+            }
+          if (done != 0)
+            {
+              rest[i].iov_base = static_cast<uint8_t *>(rest[i].iov_base) + done;
+              rest[i].iov_len -= done;
+            }
+        }
+    }
+
+  public:
+    class iterator
+    {
+      iovec_output * m;
+    public:
+      using iterator_category = std::output_iterator_tag;
+      using value_type = void;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = void;
+
+      explicit iterator(iovec_output * m_)
+        : m(m_)
+      {
+      }
+
+      iterator & operator=(uint8_t c)
+      {
+        *m->acquire(1) = c;
+        return *this;
+      }
+
+      iterator & operator*() { return *this; }
+      iterator & operator++() { return *this; }
+      iterator & operator++(int) { return *this; }
+
+      iovec_output * sink() const { return m; }
+    };
+
+    /*
+      Runs of at least threshold bytes are referenced instead of copied.
+    */
+    explicit iovec_output(size_t threshold = 4096)
+      : m_threshold(threshold), m_size(0)
+    {
+    }
+
+    /*
+      Returns a pointer to the next n bytes of the scratch buffer. The pointer is valid until the next call.
+    */
+    uint8_t * acquire(size_t n)
+    {
+      size_t offset = m_scratch.size();
+      if (m_segments.empty() || m_segments.back().data != nullptr)
+        {
+          m_segments.push_back(segment{nullptr, offset, 0});
+        }
+      m_segments.back().size += n;
+      m_scratch.resize(offset + n);
+      m_size += n;
+      return m_scratch.data() + offset;
+    }
+
+    /*
+      Records the n bytes at p as part of the output if n is at least the threshold, and returns whether it did.
+    */
+    bool reference(uint8_t const * p, size_t n)
+    {
+      if (n < m_threshold) return false;
+      m_segments.push_back(segment{p, 0, n});
+      m_size += n;
+      return true;
+    }
+
+    iterator begin() { return iterator(this); }
+
+    /*
+      Total number of bytes written.
+    */
+    size_t size() const { return m_size; }
+
+    /*
+      Number of bytes copied to the scratch buffer.
+    */
+    size_t copied() const { return m_scratch.size(); }
+
+    /*
+      The output as a list of iovecs. Valid until the sink is written to again.
+    */
+    std::vector<struct iovec> const & iovecs()
+    {
+      m_iov.clear();
+      m_iov.reserve(m_segments.size());
+      for (segment const & s : m_segments)
+        {
+          if (s.size == 0) continue;
+          uint8_t const * p = s.data != nullptr ? s.data : m_scratch.data() + s.offset;
+          struct iovec v;
+          v.iov_base = const_cast<uint8_t *>(p);
+          v.iov_len = s.size;
+          m_iov.push_back(v);
+        }
+      return m_iov;
+    }
+
+    /*
+      Writes the whole output to fd with writev, retrying after short writes.
+    */
+    void write_all(int fd)
+    {
+      write_loop("writev", [fd](struct iovec * iov, size_t count) { return ::writev(fd, iov, int(count)); });
+    }
+
+    /*
+      Sends the whole output on the socket fd with sendmsg, retrying after short sends.
+    */
+    void send_all(int fd, int flags = 0)
+    {
+      write_loop("sendmsg", [fd, flags](struct iovec * iov, size_t count)
+                 {
+                   struct msghdr msg = {};
+                   msg.msg_iov = iov;
+                   msg.msg_iovlen = count;
+                   return ::sendmsg(fd, &msg, flags);
+                 });
+    }
+
+    /*
+      Empties the sink so it can be reused.
+    */
+    void clear()
+    {
+      m_scratch.clear();
+      m_segments.clear();
+      m_iov.clear();
+      m_size = 0;
+    }
+  };
+
+  template <>
+  struct contiguous_output_helper<iovec_output::iterator>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t* acquire(iovec_output::iterator & it, size_t n)
+    {
+      return it.sink()->acquire(n);
+    }
+  };
+
+  template <>
+  struct object_output_helper<iovec_output::iterator>
+  {
+    static bool reference(iovec_output::iterator & it, uint8_t const * src, size_t n)
+    {
+      return it.sink()->reference(src, n);
+    }
+
+    static iovec_output::iterator write(uint8_t const * src, size_t n, iovec_output::iterator out)
+    {
+      if (reference(out, src, n)) return out;
+      return byte_output_helper<iovec_output::iterator>::write(src, n, out);
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,748 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RPNX_SERIAL_LZ_HH
+#define RPNX_SERIAL_LZ_HH
+
+#if defined(__has_include)
+#if __has_include("serial_traits.hpp")
+#include "serial_traits.hpp"
+#else
+#include "serial_traits"
+#endif
+#else
+#include "serial_traits.hpp"
+#endif
+
+#include <vector>
+
+namespace rpnx
+{
+  /*
+    Block compressor.
+
+    A byte oriented LZ77 codec in the style of LZ4: each sequence is a token (literal count in the high
+    nibble, match length minus 4 in the low nibble, 15 meaning more length bytes follow), the literals,
+    and a two byte little endian match offset. The last sequence of a block has literals only.
+    Blocks are compressed independently, so memory use is bounded by the block size.
+  */
+  struct lz_codec
+  {
+    static constexpr unsigned hash_bits = 14;
+    static constexpr size_t min_match = 4;
+    static constexpr size_t last_literals = 5;
+    static constexpr size_t max_offset = 65535;
+
+    /*
+      The largest block a stream may use unless the reader agrees to a larger one. Readers reject frames
+      over their limit, so malformed input can't make them allocate more than about twice this.
+    */
+    static constexpr size_t max_block_size = size_t(1) << 24;
+
+    /*
+      Largest compressed size of n bytes.
+    */
+    static constexpr size_t bound(size_t n)
+    {
+      return n + n/255 + 16;
+    }
+
+    /*
+      Compresses src[0..n) into dst, which must have room for bound(n) bytes, and returns the compressed size.
+      table must have room for 1 << hash_bits entries.
+    */
+    static size_t compress(uint8_t const * src, size_t n, uint8_t * dst, uint32_t * table)
+    {
+      std::memset(table, 0, sizeof(uint32_t) << hash_bits);
+      uint8_t * op = dst;
+      size_t anchor = 0;
+      size_t ip = 0;
+      if (n >= min_match + last_literals)
+        {
+          size_t limit = n - last_literals;
+          while (ip + min_match <= limit)
+            {
+              uint32_t seq = load_le<uint32_t>(src + ip);
+              uint32_t h = hash(seq);
+              size_t ref = table[h];
+              // Positions are stored plus one so that zero means empty.
+              table[h] = uint32_t(ip + 1);
+              if (ref == 0 || ip - (ref - 1) > max_offset || load_le<uint32_t>(src + ref - 1) != seq)
+                {
+                  // Step faster through data that doesn't match.
+                  ip += 1 + ((ip - anchor) >> 6);
+                  continue;
+                }
+              ref--;
+              size_t len = match_length(src, ref, ip, limit);
+              op = write_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+              ip += len;
+              anchor = ip;
+            }
+        }
+      return size_t(write_literals(op, src + anchor, n - anchor) - dst);
+    }
+
+    /*
+      Decompresses src[0..n) into exactly raw bytes at dst. Throws deserialize_error when the block is malformed.
+    */
+    static void decompress(uint8_t const * src, size_t n, uint8_t * dst, size_t raw)
+    {
+      uint8_t const * ip = src;
+      uint8_t const * iend = src + n;
+      uint8_t * op = dst;
+      uint8_t * oend = dst + raw;
+      while (true)
+        {
+          if (ip == iend) throw deserialize_error("truncated compressed block");
+          unsigned token = *ip++;
+          size_t lit = token >> 4;
+          if (lit == 15) ip = read_length(ip, iend, lit);
+          if (size_t(iend - ip) < lit || size_t(oend - op) < lit) throw deserialize_error("malformed compressed block");
+          if (lit != 0) std::memcpy(op, ip, lit);
+          op += lit;
+          ip += lit;
+          if (ip == iend) break;
+          if (iend - ip < 2) throw deserialize_error("truncated compressed block");
+          size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+          ip += 2;
+          if (offset == 0 || offset > size_t(op - dst)) throw deserialize_error("malformed compressed block");
+          size_t len = token & 15;
+          if (len == 15) ip = read_length(ip, iend, len);
+          len += min_match;
+          if (size_t(oend - op) < len) throw deserialize_error("malformed compressed block");
+          uint8_t const * ref = op - offset;
+          if (offset >= len)
+            {
+              std::memcpy(op, ref, len);
+              op += len;
+            }
+          else
+            {
+              // Overlapping match, which repeats the last offset bytes.
+              for (size_t i = 0; i < len; i++) *op++ = *ref++;
+            }
+        }
+      if (op != oend) throw deserialize_error("malformed compressed block");
+    }
+
+  private:
+    static uint32_t hash(uint32_t seq)
+    {
+      return (seq * 2654435761u) >> (32 - hash_bits);
+    }
+
+    static size_t match_length(uint8_t const * src, size_t ref, size_t ip, size_t limit)
+    {
+      size_t len = min_match;
+      while (ip + len + 8 <= limit)
+        {
+          uint64_t x = load_le64(src + ip + len) ^ load_le64(src + ref + len);
+          if (x != 0) return len + count_trailing_zeros64(x)/8;
+          len += 8;
+        }
+      while (ip + len < limit && src[ref + len] == src[ip + len]) len++;
+      return len;
+    }
+
+    static uint8_t * write_length(uint8_t * op, size_t len)
+    {
+      len -= 15;
+      while (len >= 255)
+        {
+          *op++ = 255;
+          len -= 255;
+        }
+      *op++ = uint8_t(len);
+      return op;
+    }
+
+    static uint8_t const * read_length(uint8_t const * ip, uint8_t const * iend, size_t & len)
+    {
+      uint8_t b;
+      do
+        {
+          if (ip == iend) throw deserialize_error("truncated compressed block");
+          b = *ip++;
+          len += b;
+        }
+      while (b == 255);
+      return ip;
+    }
+
+    static uint8_t * write_literals(uint8_t * op, uint8_t const * lit, size_t count)
+    {
+      *op++ = uint8_t((count >= 15 ? 15 : count) << 4);
+      if (count >= 15) op = write_length(op, count);
+      if (count != 0) std::memcpy(op, lit, count);
+      return op + count;
+    }
+
+    static uint8_t * write_sequence(uint8_t * op, uint8_t const * lit, size_t count, size_t offset, size_t len)
+    {
+      size_t m = len - min_match;
+      *op++ = uint8_t((count >= 15 ? 15 : count) << 4 | (m >= 15 ? 15 : m));
+      if (count >= 15) op = write_length(op, count);
+      if (count != 0) std::memcpy(op, lit, count);
+      op += count;
+      *op++ = uint8_t(offset & 0xFF);
+      *op++ = uint8_t(offset >> 8);
+      if (m >= 15) op = write_length(op, m);
+      return op;
+    }
+  };
+
+  /*
+    Compressed stream format.
+
+    A stream is a sequence of frames, each a uintany raw size, then a uintany holding the payload size
+    shifted left by one with the low bit set when the payload is compressed, then the payload. Blocks that
+    don't shrink are stored as is. A frame with a raw size of zero ends the stream. Raw sizes are at most
+    the block size the stream was written with, which readers limit to lz_codec::max_block_size unless
+    told otherwise.
+  */
+  template <typename It>
+  class lz_output;
+
+  template <typename It>
+  class lz_output_iterator
+  {
+    lz_output<It> * m;
+  public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    explicit lz_output_iterator(lz_output<It> * m_)
+      : m(m_)
+    {
+    }
+
+    lz_output_iterator & operator=(uint8_t c)
+    {
+      *m->acquire(1) = c;
+      return *this;
+    }
+
+    lz_output_iterator & operator*() { return *this; }
+    lz_output_iterator & operator++() { return *this; }
+    lz_output_iterator & operator++(int) { return *this; }
+
+    lz_output<It> * sink() const { return m; }
+  };
+
+  /*
+    Output sink that compresses what is serialized into it block by block and writes the frames to out.
+
+    Only one block is buffered, so serializing and compressing take a single pass. Runs of bytes longer
+    than a block (large strings and vectors of integers) are written a block at a time (see
+    output_chunk_helper), and every frame holds at most one block. A single fixed size value larger than
+    a block is buffered whole and written as several frames.
+    close() must be called (or the sink destroyed) to write the last block and the end of the stream.
+  */
+  template <typename It>
+  class lz_output
+  {
+    It m_out;
+    std::vector<uint8_t> m_block;
+    size_t m_size;
+    std::vector<uint8_t> m_large;
+    std::vector<uint8_t> m_packed;
+    std::vector<uint32_t> m_table;
+    bool m_closed;
+
+    void write_frame(uint8_t const * src, size_t n)
+    {
+      size_t packed = lz_codec::compress(src, n, m_packed.data(), m_table.data());
+      m_out = serial_traits<uintany>::serialize(n, m_out);
+      if (packed < n)
+        {
+          m_out = serial_traits<uintany>::serialize(packed << 1 | 1, m_out);
+          m_out = byte_output_helper<It>::write(m_packed.data(), packed, m_out);
+        }
+      else
+        {
+          m_out = serial_traits<uintany>::serialize(n << 1, m_out);
+          m_out = byte_output_helper<It>::write(src, n, m_out);
+        }
+    }
+
+  public:
+    using iterator = lz_output_iterator<It>;
+
+    /*
+      block_size must be between 1 and lz_codec::max_block_size unless the reader is given a larger limit.
+    */
+    explicit lz_output(It out, size_t block_size = 65536)
+      : m_out(out), m_block(block_size), m_size(0), m_packed(lz_codec::bound(block_size)), m_table(size_t(1) << lz_codec::hash_bits), m_closed(false)
+    {
+      if (block_size == 0) throw std::invalid_argument("lz block size must not be zero");
+    }
+
+    lz_output(lz_output const &) = delete;
+    lz_output & operator=(lz_output const &) = delete;
+
+    ~lz_output()
+    {
+      try
+        {
+          close();
+        }
+      catch (...)
+        {
+        }
+    }
+
+    /*
+      Returns a pointer to the next n bytes of the current block, compressing the block first when they don't fit.
+    */
+    uint8_t * acquire(size_t n)
+    {
+      if (m_size + n > m_block.size() || !m_large.empty())
+        {
+          flush();
+          if (n > m_block.size())
+            {
+              m_large.resize(n);
+              return m_large.data();
+            }
+        }
+      uint8_t * p = m_block.data() + m_size;
+      m_size += n;
+      return p;
+    }
+
+    iterator begin() { return iterator(this); }
+
+    size_t block_size() const { return m_block.size(); }
+
+    /*
+      Compresses and writes out the buffered bytes as frames of at most one block.
+    */
+    void flush()
+    {
+      if (m_size != 0) write_frame(m_block.data(), m_size);
+      m_size = 0;
+      for (size_t i = 0; i < m_large.size(); i += m_block.size())
+        {
+          write_frame(m_large.data() + i, std::min(m_block.size(), m_large.size() - i));
+        }
+      m_large.clear();
+      m_large.shrink_to_fit();
+    }
+
+    /*
+      Writes the last block and the end of the stream, and returns the advanced output iterator.
+    */
+    It close()
+    {
+      if (m_closed) return m_out;
+      m_closed = true;
+      flush();
+      m_out = serial_traits<uintany>::serialize(size_t(0), m_out);
+      return m_out;
+    }
+  };
+
+  template <typename It>
+  struct contiguous_output_helper<lz_output_iterator<It>>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t* acquire(lz_output_iterator<It> & it, size_t n)
+    {
+      return it.sink()->acquire(n);
+    }
+  };
+
+  template <typename It>
+  struct output_chunk_helper<lz_output_iterator<It>>
+  {
+    static size_t size(lz_output_iterator<It> const & it)
+    {
+      return it.sink()->block_size();
+    }
+  };
+
+  /*
+    Checks a frame header against the reader's block size limit before anything is allocated for it.
+  */
+  inline void lz_check_frame(size_t raw, size_t tag, size_t max_block)
+  {
+    if (raw > max_block) throw deserialize_error("compressed block exceeds the maximum block size");
+    size_t payload = tag >> 1;
+    if ((tag & 1) ? payload > lz_codec::bound(raw) : payload != raw) throw deserialize_error("malformed compressed frame");
+  }
+
+  /*
+    Decodes one frame payload into block. raw is the raw size from the frame header and tag the
+    payload size and compression flag, which lz_check_frame has accepted.
+  */
+  inline void lz_decode_frame(uint8_t const * payload, size_t raw, size_t tag, std::vector<uint8_t> & block)
+  {
+    block.resize(raw);
+    if (tag & 1)
+      {
+        lz_codec::decompress(payload, tag >> 1, block.data(), raw);
+      }
+    else
+      {
+        if ((tag >> 1) != raw) throw deserialize_error("malformed stored block");
+        std::memcpy(block.data(), payload, raw);
+      }
+  }
+
+  template <typename It>
+  class lz_input;
+
+  template <typename It>
+  class lz_input_iterator
+  {
+    lz_input<It> * m;
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = uint8_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = uint8_t const *;
+    using reference = uint8_t;
+
+    /*
+      Result of post increment, which holds the byte that was current.
+    */
+    class proxy
+    {
+      uint8_t c;
+    public:
+      explicit proxy(uint8_t c_)
+        : c(c_)
+      {
+      }
+
+      uint8_t operator*() const { return c; }
+    };
+
+    lz_input_iterator()
+      : m(nullptr)
+    {
+    }
+
+    explicit lz_input_iterator(lz_input<It> * m_)
+      : m(m_)
+    {
+    }
+
+    uint8_t operator*() const { return m->peek(); }
+
+    lz_input_iterator & operator++()
+    {
+      m->advance();
+      return *this;
+    }
+
+    proxy operator++(int)
+    {
+      proxy p(m->peek());
+      m->advance();
+      return p;
+    }
+
+    bool at_end() const { return m == nullptr || m->at_end(); }
+
+    bool operator==(lz_input_iterator const & other) const { return at_end() == other.at_end(); }
+    bool operator!=(lz_input_iterator const & other) const { return at_end() != other.at_end(); }
+
+    lz_input<It> * source() const { return m; }
+  };
+
+  /*
+    Input source that reads frames from in and decompresses them on demand, one block at a time.
+    Iterators from begin() can be passed to deserialize and to the iterator overloads of the async
+    deserializers. Reading past the end of the stream throws deserialize_error.
+  */
+  template <typename It>
+  class lz_input
+  {
+    It m_in;
+    std::vector<uint8_t> m_block;
+    size_t m_pos;
+    std::vector<uint8_t> m_packed;
+    size_t m_max_block;
+    bool m_end;
+
+    bool next_block()
+    {
+      while (!m_end)
+        {
+          size_t raw;
+          m_in = serial_traits<uintany>::deserialize(raw, m_in);
+          m_pos = 0;
+          if (raw == 0)
+            {
+              m_end = true;
+              m_block.clear();
+              return false;
+            }
+          size_t tag;
+          m_in = serial_traits<uintany>::deserialize(tag, m_in);
+          lz_check_frame(raw, tag, m_max_block);
+          m_packed.resize(tag >> 1);
+          m_in = byte_input_helper<It>::read(m_packed.data(), m_packed.size(), m_in);
+          lz_decode_frame(m_packed.data(), raw, tag, m_block);
+          return true;
+        }
+      return false;
+    }
+
+    void fill()
+    {
+      if (m_pos == m_block.size() && !next_block()) throw deserialize_error("unexpected end of input");
+    }
+
+  public:
+    using iterator = lz_input_iterator<It>;
+
+    /*
+      Frames with more than max_block raw bytes are rejected with deserialize_error.
+    */
+    explicit lz_input(It in, size_t max_block = lz_codec::max_block_size)
+      : m_in(in), m_pos(0), m_max_block(max_block), m_end(false)
+    {
+    }
+
+    lz_input(lz_input const &) = delete;
+    lz_input & operator=(lz_input const &) = delete;
+
+    uint8_t peek()
+    {
+      fill();
+      return m_block[m_pos];
+    }
+
+    void advance()
+    {
+      fill();
+      m_pos++;
+    }
+
+    /*
+      The number of bytes left in the current block, decoding the next block first if this one is used up.
+    */
+    size_t available()
+    {
+      fill();
+      return m_block.size() - m_pos;
+    }
+
+    /*
+      Returns a pointer to the next n bytes, which must fit in the current block (see available()), and
+      consumes them. The pointer is valid until the next block is decoded.
+    */
+    uint8_t const * acquire(size_t n)
+    {
+      if (available() < n) throw deserialize_error("span crosses an lz block");
+      uint8_t const * p = m_block.data() + m_pos;
+      m_pos += n;
+      return p;
+    }
+
+    /*
+      Copies the next n bytes to dest and consumes them, one block at a time.
+    */
+    void read(uint8_t * dest, size_t n)
+    {
+      while (n != 0)
+        {
+          size_t k = available();
+          if (k > n) k = n;
+          std::memcpy(dest, m_block.data() + m_pos, k);
+          m_pos += k;
+          dest += k;
+          n -= k;
+        }
+    }
+
+    /*
+      True once every byte of the stream has been read.
+    */
+    bool at_end()
+    {
+      return m_pos == m_block.size() && !next_block();
+    }
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+    /*
+      The source iterator, past the end of the stream once at_end() is true.
+    */
+    It source() const { return m_in; }
+  };
+
+  template <typename It>
+  struct contiguous_input_helper<lz_input_iterator<It>>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t const* acquire(lz_input_iterator<It> & it, size_t n)
+    {
+      return it.source()->acquire(n);
+    }
+  };
+
+  template <typename It>
+  struct input_chunk_helper<lz_input_iterator<It>>
+  {
+    static size_t size(lz_input_iterator<It> const & it)
+    {
+      return it.source()->available();
+    }
+  };
+
+  template <typename It>
+  struct byte_input_helper<lz_input_iterator<It>, true>
+  {
+    static lz_input_iterator<It> read(uint8_t * dest, size_t n, lz_input_iterator<It> in)
+    {
+      in.source()->read(dest, n);
+      return in;
+    }
+  };
+
+  /*
+    Push style decompressor for the async deserializers.
+
+    insert(ds, data, n) takes compressed bytes as they arrive, decompresses each frame once it is complete,
+    and feeds the result to ds until ds is ready. Decompressed bytes that ds doesn't take are kept for the
+    next value, so after get() the same call can be repeated with the rest of the input (possibly none).
+  */
+  class lz_async_input
+  {
+    std::vector<uint8_t> m_frame;
+    std::vector<uint8_t> m_block;
+    size_t m_pos;
+    size_t m_max_block;
+
+    /*
+      Returns the length of the uintany at p, or zero when it isn't complete within n bytes.
+    */
+    static size_t varint_length(uint8_t const * p, size_t n)
+    {
+      for (size_t i = 0; i < n; i++)
+        {
+          if (!(p[i] & 0x80)) return i + 1;
+        }
+      if (n >= serial_traits<uintany>::encoded_size(UINTMAX_MAX)) throw deserialize_error("varint out of range");
+      return 0;
+    }
+
+    /*
+      Returns the size of the frame at the start of m_frame, or zero when the header isn't complete.
+    */
+    size_t frame_length(size_t & header, size_t & raw, size_t & tag) const
+    {
+      uint8_t const * p = m_frame.data();
+      uint8_t const * end = p + m_frame.size();
+      size_t a = varint_length(p, m_frame.size());
+      if (a == 0) return 0;
+      serial_traits<uintany>::deserialize(raw, p, end);
+      if (raw == 0)
+        {
+          header = a;
+          tag = 0;
+          return a;
+        }
+      size_t b = varint_length(p + a, m_frame.size() - a);
+      if (b == 0) return 0;
+      serial_traits<uintany>::deserialize(tag, p + a, end);
+      lz_check_frame(raw, tag, m_max_block);
+      header = a + b;
+      return saturating_add(header, tag >> 1);
+    }
+
+  public:
+    /*
+      Frames with more than max_block raw bytes are rejected with deserialize_error.
+    */
+    explicit lz_async_input(size_t max_block = lz_codec::max_block_size)
+      : m_pos(0), m_max_block(max_block)
+    {
+    }
+
+    void reset()
+    {
+      m_frame.clear();
+      m_block.clear();
+      m_pos = 0;
+    }
+
+    template <typename D>
+    auto insert(D & ds, uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+    {
+      size_t used = 0;
+      while (true)
+        {
+          if (m_pos != m_block.size())
+            {
+              auto r = ds.insert(m_block.data() + m_pos, m_block.size() - m_pos);
+              m_pos += r.first;
+              if (r.second) return {used, true};
+            }
+          if (used == n) return {used, false};
+
+          // Take just enough input to complete the header, then the payload, of the next frame.
+          size_t header, raw, tag;
+          size_t len = frame_length(header, raw, tag);
+          while (len == 0 && used != n)
+            {
+              m_frame.push_back(data[used++]);
+              len = frame_length(header, raw, tag);
+            }
+          if (len == 0) return {used, false};
+          size_t k = len - m_frame.size();
+          if (k > n - used) k = n - used;
+          m_frame.insert(m_frame.end(), data + used, data + used + k);
+          used += k;
+          if (m_frame.size() != len) return {used, false};
+          if (raw != 0) lz_decode_frame(m_frame.data() + header, raw, tag, m_block);
+          else m_block.clear();
+          m_pos = 0;
+          m_frame.clear();
+        }
+    }
+  };
+
+  /*
+    Serializes in through an lz_output writing to out, and returns the advanced out.
+  */
+  template <typename T, typename It>
+  It serialize_compressed(T const & in, It out, size_t block_size = 65536)
+  {
+    lz_output<It> sink(out, block_size);
+    serialize(in, sink.begin());
+    return sink.close();
+  }
+
+  /*
+    Deserializes out from the compressed stream at in, and returns the source iterator past the end of the stream.
+    Streams written with blocks larger than lz_codec::max_block_size need a larger max_block.
+  */
+  template <typename T, typename It>
+  It deserialize_compressed(T & out, It in, size_t max_block = lz_codec::max_block_size)
+  {
+    lz_input<It> source(in, max_block);
+    deserialize(out, source.begin());
+    if (!source.at_end()) throw deserialize_error("trailing data in compressed stream");
+    return source.source();
+  }
+}
+
+#endif
@@ -0,0 +1,278 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RPNX_SERIAL_MMAP_HH
+#define RPNX_SERIAL_MMAP_HH
+
+#if defined(__has_include)
+#if __has_include("serial_traits.hpp")
+#include "serial_traits.hpp"
+#else
+#include "serial_traits"
+#endif
+#else
+#include "serial_traits.hpp"
+#endif
+
+#include <string>
+#include <system_error>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace rpnx
+{
+  /*
+    File backed output sink.
+
+    Bytes are written straight into a shared mapping of the file, so serializing a snapshot needs neither
+    an in-memory copy nor a separate write pass. The file grows in large chunks as needed (or can be
+    pre-sized with reserve()), and is truncated to the number of bytes written when the sink is closed.
+    System errors are reported by throwing std::system_error.
+  */
+  class mmap_output
+  {
+    int m_fd;
+    uint8_t * m_data;
+    size_t m_size;
+    size_t m_capacity;
+    size_t m_chunk;
+
+    static void fail(char const * what)
+    {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    /*
+      Grows the file and its mapping to capacity. On failure the old mapping, and so the bytes already
+      written, are kept.
+    */
+    void remap(size_t capacity)
+    {
+      if (ftruncate(m_fd, off_t(capacity)) != 0) fail("ftruncate");
+      void * p;
+#if defined(__linux__)
+      if (m_data != nullptr)
+        {
+          p = mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE);
+          if (p == MAP_FAILED) fail("mremap");
+          m_data = static_cast<uint8_t *>(p);
+          m_capacity = capacity;
+          return;
+        }
+#endif
+      p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+      if (p == MAP_FAILED) fail("mmap");
+      // Both mappings are shared views of the same file, so the new one already holds the written bytes.
+      if (m_data != nullptr) munmap(m_data, m_capacity);
+      m_data = static_cast<uint8_t *>(p);
+      m_capacity = capacity;
+    }
+
+  public:
+    class iterator
+    {
+      mmap_output * m;
+    public:
+      using iterator_category = std::output_iterator_tag;
+      using value_type = void;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = void;
+
+      explicit iterator(mmap_output * m_)
+        : m(m_)
+      {
+      }
+
+      iterator & operator=(uint8_t c)
+      {
+        *m->acquire(1) = c;
+        return *this;
+      }
+
+      iterator & operator*() { return *this; }
+      iterator & operator++() { return *this; }
+      iterator & operator++(int) { return *this; }
+
+      mmap_output * sink() const { return m; }
+    };
+
+    /*
+      Creates (or truncates) the file at path. chunk is the minimum amount the file grows by.
+    */
+    explicit mmap_output(std::string const & path, size_t chunk = size_t(64) << 20)
+      : m_fd(-1), m_data(nullptr), m_size(0), m_capacity(0), m_chunk(chunk)
+    {
+      m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+      if (m_fd < 0) fail("open");
+    }
+
+    mmap_output(mmap_output const &) = delete;
+    mmap_output & operator=(mmap_output const &) = delete;
+
+    ~mmap_output()
+    {
+      try
+        {
+          close();
+        }
+      catch (...)
+        {
+        }
+    }
+
+    /*
+      Grows the file so that capacity bytes can be written without growing it again.
+    */
+    void reserve(size_t capacity)
+    {
+      if (capacity > m_capacity) remap(capacity);
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+    /*
+      Returns a pointer to the next n bytes of the file and counts them as written.
+    */
+    uint8_t * acquire(size_t n)
+    {
+      if (m_size + n > m_capacity)
+        {
+          size_t capacity = m_capacity*2;
+          if (capacity < m_capacity + m_chunk) capacity = m_capacity + m_chunk;
+          if (capacity < m_size + n) capacity = m_size + n;
+          remap(capacity);
+        }
+      uint8_t * p = m_data + m_size;
+      m_size += n;
+      return p;
+    }
+
+    iterator begin() { return iterator(this); }
+
+    size_t size() const { return m_size; }
+
+    /*
+      Unmaps the file and truncates it to the bytes written. Called by the destructor if needed.
+    */
+    void close()
+    {
+      if (m_fd < 0) return;
+      int fd = m_fd;
+      m_fd = -1;
+      if (m_data != nullptr) munmap(m_data, m_capacity);
+      m_data = nullptr;
+      int r = ftruncate(fd, off_t(m_size));
+      int e = errno;
+      ::close(fd);
+      errno = e;
+      if (r != 0) fail("ftruncate");
+    }
+  };
+
+  template <>
+  struct contiguous_output_helper<mmap_output::iterator>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t* acquire(mmap_output::iterator & it, size_t n)
+    {
+      return it.sink()->acquire(n);
+    }
+  };
+
+  template <typename T>
+  struct serial_helper<T, mmap_output::iterator>
+  {
+    static auto serialize(T const & in, mmap_output::iterator out) -> mmap_output::iterator
+    {
+      serial_reserve_helper<T>::reserve(in, *out.sink());
+      return serial_traits<T>::serialize(in, out);
+    }
+  };
+
+  /*
+    Read-only mapping of a file, advised for sequential access.
+  */
+  class mmap_input
+  {
+    uint8_t const * m_data;
+    size_t m_size;
+  public:
+    explicit mmap_input(std::string const & path)
+      : m_data(nullptr), m_size(0)
+    {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw std::system_error(errno, std::generic_category(), "open");
+      struct stat st;
+      if (fstat(fd, &st) != 0)
+        {
+          int e = errno;
+          ::close(fd);
+          throw std::system_error(e, std::generic_category(), "fstat");
+        }
+      m_size = size_t(st.st_size);
+      if (m_size != 0)
+        {
+          void * p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          int e = errno;
+          ::close(fd);
+          if (p == MAP_FAILED) throw std::system_error(e, std::generic_category(), "mmap");
+          m_data = static_cast<uint8_t const *>(p);
+          madvise(const_cast<uint8_t *>(m_data), m_size, MADV_SEQUENTIAL);
+        }
+      else
+        {
+          ::close(fd);
+        }
+    }
+
+    mmap_input(mmap_input const &) = delete;
+    mmap_input & operator=(mmap_input const &) = delete;
+
+    ~mmap_input()
+    {
+      if (m_data != nullptr) munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+
+    uint8_t const * data() const { return m_data; }
+    size_t size() const { return m_size; }
+    uint8_t const * begin() const { return m_data; }
+    uint8_t const * end() const { return m_data + m_size; }
+  };
+
+  /*
+    Serializes in to the file at path through an mmap_output.
+  */
+  template <typename T>
+  void serialize_to_file(T const & in, std::string const & path)
+  {
+    mmap_output out(path);
+    serialize(in, out.begin());
+    out.close();
+  }
+
+  /*
+    Deserializes out from the file at path through an mmap_input. The input is bounds checked, and a
+    file that is truncated, malformed or has bytes left over throws deserialize_error.
+  */
+  template <typename T>
+  void deserialize_from_file(T & out, std::string const & path)
+  {
+    mmap_input in(path);
+    if (deserialize(out, in.begin(), in.end()) != in.end()) throw deserialize_error("trailing data in file");
+  }
+}
+
+#endif
@@ -0,0 +1,540 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RPNX_SERIAL_PARALLEL_HH
+#define RPNX_SERIAL_PARALLEL_HH
+
+#if defined(__has_include)
+#if __has_include("serial_traits.hpp")
+#include "serial_traits.hpp"
+#else
+#include "serial_traits"
+#endif
+#else
+#include "serial_traits.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace rpnx
+{
+  /*
+    The number of threads to use when threads were requested, 0 meaning one per core.
+  */
+  inline size_t parallel_threads(size_t threads)
+  {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    return threads;
+  }
+
+  /*
+    The number of shards to split count elements into: at least min_shard elements each, at most four per thread.
+  */
+  inline size_t parallel_shards(size_t count, size_t threads, size_t min_shard)
+  {
+    if (min_shard == 0) min_shard = 1;
+    size_t shards = count/min_shard;
+    if (shards > 4*threads) shards = 4*threads;
+    if (shards == 0) shards = 1;
+    return shards;
+  }
+
+  /*
+    Runs f(i) for every i in [0, tasks) on up to threads threads, the calling thread included.
+    Threads take the next task index as they become free, so uneven tasks still balance. The first
+    exception thrown by a task is rethrown once every thread has stopped.
+  */
+  template <typename F>
+  void parallel_for(size_t tasks, size_t threads, F && f)
+  {
+    threads = parallel_threads(threads);
+    if (threads > tasks) threads = tasks;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    auto run = [&]()
+      {
+        size_t i;
+        while (!failed.load(std::memory_order_relaxed) && (i = next.fetch_add(1)) < tasks)
+          {
+            try
+              {
+                f(i);
+              }
+            catch (...)
+              {
+                if (!failed.exchange(true)) error = std::current_exception();
+              }
+          }
+      };
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 1 ? threads - 1 : 0);
+    for (size_t t = 1; t < threads; t++) workers.emplace_back(run);
+    run();
+    for (auto & w : workers) w.join();
+    if (error) std::rethrow_exception(error);
+  }
+
+  /*
+    Parallel serialization.
+
+    Containers (vector-like, set-like and map-like) are split into shards of consecutive elements. The
+    encoded size of every shard is computed in parallel, an exclusive prefix sum of the sizes gives each
+    shard its offset after the count, and the shards are then encoded in parallel straight into their
+    slots of one buffer. The result is byte for byte what serialize() writes. Other types, and containers
+    too small to be worth splitting, are serialized on the calling thread.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case()>
+  struct parallel_container_helper
+  {
+    static constexpr bool value = C == 3 || C == 5 || C == 8;
+  };
+
+  template <typename T, bool F = has_noarg_serial_size<typename T::value_type>::value>
+  struct shard_size_helper;
+
+  template <typename T>
+  struct shard_size_helper<T, true>
+  {
+    static size_t serial_size(typename T::const_iterator, size_t count)
+    {
+      return count*serial_traits<typename T::value_type>::serial_size();
+    }
+  };
+
+  template <typename T>
+  struct shard_size_helper<T, false>
+  {
+    static size_t serial_size(typename T::const_iterator first, size_t count)
+    {
+      size_t sz = 0;
+      for (size_t i = 0; i < count; i++, ++first)
+        {
+          sz += serial_size_helper<typename T::value_type>::serial_size(*first);
+        }
+      return sz;
+    }
+  };
+
+  template <typename T, bool B = bulk_element_helper<T>::value>
+  struct shard_write_helper;
+
+  template <typename T>
+  struct shard_write_helper<T, true>
+  {
+    static void serialize(typename T::const_iterator first, size_t count, uint8_t * out)
+    {
+      bulk_element_helper<T>::encode(&*first, count, out);
+    }
+  };
+
+  template <typename T>
+  struct shard_write_helper<T, false>
+  {
+    static void serialize(typename T::const_iterator first, size_t count, uint8_t * out)
+    {
+      for (size_t i = 0; i < count; i++, ++first)
+        {
+          out = serial_traits<typename T::value_type>::serialize(*first, out);
+        }
+    }
+  };
+
+  template <typename T, bool B = parallel_container_helper<T>::value>
+  class parallel_serializer;
+
+  template <typename T>
+  class parallel_serializer<T, false>
+  {
+    T const & m_in;
+    size_t m_size;
+  public:
+    parallel_serializer(T const & in, size_t, size_t = 0)
+      : m_in(in), m_size(serial_size_helper<T>::serial_size(in))
+    {
+    }
+
+    size_t size() const { return m_size; }
+
+    uint8_t * write(uint8_t * out) const
+    {
+      return serial_traits<T>::serialize(m_in, out);
+    }
+  };
+
+  template <typename T>
+  class parallel_serializer<T, true>
+  {
+    using E = typename T::value_type;
+    using const_iterator = typename T::const_iterator;
+
+    T const & m_in;
+    std::vector<const_iterator> m_bounds;
+    std::vector<size_t> m_counts;
+    std::vector<size_t> m_offsets;
+    size_t m_header;
+    size_t m_size;
+    size_t m_threads;
+
+    static size_t shard_size(const_iterator first, size_t count)
+    {
+      return shard_size_helper<T>::serial_size(first, count);
+    }
+
+    static void write_shard(const_iterator first, size_t count, uint8_t * out)
+    {
+      shard_write_helper<T>::serialize(first, count, out);
+    }
+
+  public:
+    /*
+      Plans the shards for in. Shards have at least min_shard elements, and there are at most four per thread.
+    */
+    parallel_serializer(T const & in, size_t threads, size_t min_shard = 4096)
+      : m_in(in), m_threads(parallel_threads(threads))
+    {
+      size_t n = in.size();
+      m_header = serial_traits<uintany>::encoded_size(n);
+      // An empty container is just its count, so it gets no shards.
+      size_t shards = n == 0 ? 0 : parallel_shards(n, m_threads, min_shard);
+
+      auto it = in.begin();
+      for (size_t s = 0; s < shards; s++)
+        {
+          size_t count = n/shards + (s < n%shards);
+          m_bounds.push_back(it);
+          m_counts.push_back(count);
+          std::advance(it, count);
+        }
+
+      std::vector<size_t> sizes(shards);
+      if (has_noarg_serial_size<E>::value || shards <= 1)
+        {
+          for (size_t s = 0; s < shards; s++) sizes[s] = shard_size(m_bounds[s], m_counts[s]);
+        }
+      else
+        {
+          parallel_for(shards, m_threads, [&](size_t s) { sizes[s] = shard_size(m_bounds[s], m_counts[s]); });
+        }
+
+      m_offsets.resize(shards);
+      m_size = m_header;
+      for (size_t s = 0; s < shards; s++)
+        {
+          m_offsets[s] = m_size;
+          m_size += sizes[s];
+        }
+    }
+
+    /*
+      The total encoded size.
+    */
+    size_t size() const { return m_size; }
+
+    /*
+      Encodes the container to out, which must have room for size() bytes, and returns out + size().
+    */
+    uint8_t * write(uint8_t * out) const
+    {
+      serial_traits<uintany>::serialize(m_in.size(), out);
+      if (m_bounds.size() <= 1)
+        {
+          for (size_t s = 0; s < m_bounds.size(); s++) write_shard(m_bounds[s], m_counts[s], out + m_offsets[s]);
+        }
+      else
+        {
+          parallel_for(m_bounds.size(), m_threads, [&](size_t s) { write_shard(m_bounds[s], m_counts[s], out + m_offsets[s]); });
+        }
+      return out + m_size;
+    }
+  };
+
+  /*
+    Serializes in to out, which must have room for serial_size(in) bytes, on up to threads threads
+    (0 for one per core). Returns a pointer past the last byte written.
+  */
+  template <typename T>
+  uint8_t * serialize_parallel(T const & in, uint8_t * out, size_t threads = 0)
+  {
+    return parallel_serializer<T>(in, threads).write(out);
+  }
+
+  /*
+    Appends the serialization of in to out, sizing out once.
+  */
+  template <typename T, typename A>
+  void serialize_parallel(T const & in, std::vector<uint8_t, A> & out, size_t threads = 0)
+  {
+    parallel_serializer<T> s(in, threads);
+    size_t old_size = out.size();
+    out.resize(old_size + s.size());
+    s.write(out.data() + old_size);
+  }
+
+  /*
+    Sparse offset index for a serialized container.
+
+    offsets[k] is the position of element k*every, counted from the start of the container's encoding
+    (so offsets[0] is the size of the count prefix). With an index a reader can start decoding at any
+    multiple of every without decoding the elements before it.
+  */
+  struct serial_index
+  {
+    size_t every;
+    std::vector<size_t> offsets;
+  };
+
+  /*
+    Builds the index of the encoding of in, with one entry every every elements.
+  */
+  template <typename T>
+  serial_index make_serial_index(T const & in, size_t every = 4096)
+  {
+    serial_index index;
+    index.every = every == 0 ? 1 : every;
+    index.offsets.reserve(in.size()/index.every + 1);
+    size_t pos = serial_traits<uintany>::encoded_size(in.size());
+    size_t i = 0;
+    for (auto const & e : in)
+      {
+        if (i++ % index.every == 0) index.offsets.push_back(pos);
+        pos += serial_size_helper<typename T::value_type>::serial_size(e);
+      }
+    return index;
+  }
+
+  /*
+    Parallel deserialization.
+
+    Vector-like containers with random access are resized once for the decoded count, and disjoint ranges
+    of elements are then decoded in place by the worker threads. Where element i starts is known either
+    because every element has the same serial size (header + i*stride) or from a serial_index. Input is
+    bounds checked as by deserialize(out, begin, end), and as there the elements are appended to out.
+    Everything else is decoded on the calling thread.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case()>
+  struct parallel_decode_helper
+  {
+    static constexpr bool value = false;
+  };
+
+  template <typename T>
+  struct parallel_decode_helper<T, 3>
+  {
+    static constexpr bool value = std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<typename T::iterator>::iterator_category>::value;
+  };
+
+  template <typename T, bool B = bulk_element_helper<T>::value>
+  struct stride_decode_helper;
+
+  template <typename T>
+  struct stride_decode_helper<T, true>
+  {
+    static void decode(T & out, size_t first, size_t count, uint8_t const * in)
+    {
+      bulk_element_helper<T>::decode(in, count, &out[first]);
+    }
+  };
+
+  template <typename T>
+  struct stride_decode_helper<T, false>
+  {
+    static void decode(T & out, size_t first, size_t count, uint8_t const * in)
+    {
+      for (size_t i = 0; i < count; i++)
+        {
+          in = serial_traits<typename T::value_type>::deserialize(out[first + i], in);
+        }
+    }
+  };
+
+  template <typename T, bool B = parallel_decode_helper<T>::value, bool F = has_noarg_serial_size<typename T::value_type>::value>
+  struct parallel_deserializer
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end, size_t)
+    {
+      return checked_deserialize_helper<T>::deserialize(out, in, end);
+    }
+  };
+
+  template <typename T>
+  struct parallel_deserializer<T, true, true>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end, size_t threads)
+    {
+      size_t count;
+      uint8_t const * body = serial_traits<uintany>::deserialize(count, in, end);
+      if (count == 0) return body;
+      size_t stride = serial_traits<typename T::value_type>::serial_size();
+      check_count(body, end, count, stride);
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      threads = parallel_threads(threads);
+      size_t shards = parallel_shards(count, threads, 4096);
+      parallel_for(shards, threads, [&](size_t s)
+                   {
+                     size_t first = s*(count/shards) + std::min(s, count%shards);
+                     size_t n = count/shards + (s < count%shards);
+                     stride_decode_helper<T>::decode(out, old_size + first, n, body + first*stride);
+                   });
+      return body + count*stride;
+    }
+  };
+
+  /*
+    Indexed decoding. decode() appends count elements, the first at base + index.offsets[0], to out and
+    returns a pointer past the last one, which must be before end. Each shard covers whole index groups
+    and is bounds checked against the start of the next group, and the index is verified against the
+    elements as they are decoded.
+  */
+  template <typename T, bool B = parallel_decode_helper<T>::value>
+  struct indexed_deserializer
+  {
+    static uint8_t const * decode(T & out, size_t count, uint8_t const * base, uint8_t const * end, serial_index const & index, size_t)
+    {
+      if (index.offsets.empty() || index.offsets[0] > size_t(end - base)) throw deserialize_error("container index does not match input");
+      uint8_t const * p = base + index.offsets[0];
+      if (count > size_t(end - p)) throw deserialize_error("container count exceeds input");
+      for (size_t i = 0; i < count; i++)
+        {
+          typename indexed_element_helper<T>::type e = make_element<typename indexed_element_helper<T>::type>(out);
+          p = checked_deserialize_helper<typename indexed_element_helper<T>::type>::deserialize(e, p, end);
+          out.insert(out.end(), std::move(e));
+        }
+      return p;
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end, serial_index const &, size_t)
+    {
+      return checked_deserialize_helper<T>::deserialize(out, in, end);
+    }
+  };
+
+  template <typename T>
+  struct indexed_deserializer<T, true>
+  {
+    static uint8_t const * decode(T & out, size_t count, uint8_t const * base, uint8_t const * end, serial_index const & index, size_t threads)
+    {
+      if (count == 0) return base + (index.offsets.empty() ? 0 : index.offsets[0]);
+      size_t every = index.every;
+      std::vector<size_t> const & offsets = index.offsets;
+      size_t groups = every == 0 ? 0 : count/every + (count%every != 0);
+      if (groups == 0 || offsets.size() != groups || offsets[0] > size_t(end - base)) throw deserialize_error("container index does not match input");
+      for (size_t g = 1; g < groups; g++)
+        {
+          if (offsets[g] < offsets[g - 1] || offsets[g] > size_t(end - base)) throw deserialize_error("container index does not match input");
+        }
+      // Every element takes at least one byte.
+      if (count > size_t(end - base) - offsets[0]) throw deserialize_error("container count exceeds input");
+
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      threads = parallel_threads(threads);
+      size_t shards = parallel_shards(groups, threads, 1);
+      std::vector<uint8_t const *> ends(shards);
+      parallel_for(shards, threads, [&](size_t s)
+                   {
+                     size_t g = s*(groups/shards) + std::min(s, groups%shards);
+                     size_t last = g + groups/shards + (s < groups%shards);
+                     uint8_t const * p = base + offsets[g];
+                     for (; g != last; g++)
+                       {
+                         uint8_t const * limit = g + 1 < groups ? base + offsets[g + 1] : end;
+                         size_t i = g*every;
+                         size_t stop = std::min(i + every, count);
+                         for (; i != stop; i++)
+                           {
+                             p = checked_deserialize_helper<typename T::value_type>::deserialize(out[old_size + i], p, limit);
+                           }
+                         if (g + 1 < groups && p != limit) throw deserialize_error("container index does not match input");
+                       }
+                     ends[s] = p;
+                   });
+      return ends.back();
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end, serial_index const & index, size_t threads)
+    {
+      size_t count;
+      uint8_t const * body = serial_traits<uintany>::deserialize(count, in, end);
+      if (count != 0 && (index.offsets.empty() || index.offsets[0] != size_t(body - in))) throw deserialize_error("container index does not match input");
+      if (count == 0) return body;
+      return decode(out, count, in, end, index, threads);
+    }
+  };
+
+  /*
+    indexed<C, N> carries its own index, so vector-like ones are decoded in parallel without an external
+    serial_index. As with its deserialize(), the contents of out are replaced.
+  */
+  template <typename C, size_t N, bool B, bool F>
+  struct parallel_deserializer<indexed<C, N>, B, F>
+  {
+    static uint8_t const * deserialize(indexed<C, N> & out, uint8_t const * in, uint8_t const * end, size_t threads)
+    {
+      indexed_header h;
+      uint8_t const * first = h.read(in, end);
+      if (h.every == 0 || h.count == 0) return serial_traits<indexed<C, N>>::deserialize(out, in, end);
+
+      serial_index index;
+      index.every = h.every;
+      // The index has one entry per byte at most.
+      if (h.groups() - 1 > size_t(end - first) - h.size) throw deserialize_error("container count exceeds input");
+      index.offsets.reserve(h.groups());
+      index.offsets.push_back(0);
+      uint8_t const * p = first + h.size;
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          size_t d;
+          p = serial_traits<uintany>::deserialize(d, p, end);
+          if (d > h.size - index.offsets.back()) throw deserialize_error("container index does not match input");
+          index.offsets.push_back(index.offsets.back() + d);
+        }
+
+      out.clear();
+      C & c = out;
+      if (indexed_deserializer<C>::decode(c, h.count, first, first + h.size, index, threads) != first + h.size)
+        {
+          throw deserialize_error("container size does not match input");
+        }
+      return p;
+    }
+  };
+
+  /*
+    Deserializes out from [begin, end) on up to threads threads (0 for one per core). Vector-like
+    containers of fixed size elements, and indexed<C, N> vector-like containers, are decoded in
+    parallel, anything else as by deserialize().
+    Returns a pointer past the last byte read.
+  */
+  template <typename T>
+  uint8_t const * deserialize_parallel(T & out, uint8_t const * begin, uint8_t const * end, size_t threads = 0)
+  {
+    return parallel_deserializer<T>::deserialize(out, begin, end, threads);
+  }
+
+  /*
+    As above, using index (see make_serial_index) to also decode vector-like containers of variable size
+    elements in parallel.
+  */
+  template <typename T>
+  uint8_t const * deserialize_parallel(T & out, uint8_t const * begin, uint8_t const * end, serial_index const & index, size_t threads = 0)
+  {
+    return indexed_deserializer<T>::deserialize(out, begin, end, index, threads);
+  }
+}
+
+#endif
@@ -13,8 +13,15 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include <inttypes.h>
 #include <iostream>
+#include <iterator>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <tuple>
 #include <map>
+#include <deque>
+#include <list>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
@@ -22,6 +29,28 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <type_traits>
 #include <vector>
 #include <cstdint>
+#include <stdexcept>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#include <optional>
+#include <variant>
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+#endif
+
+#if __cplusplus > 201703L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 namespace rpnx
 {
@@ -40,7 +69,7 @@ namespace rpnx
 
     static typename It::container_type* extract(It const& it)
     {
-      return it.container;
+      return it.*(&container_extractor::container);
     }
   };
 
@@ -94,7 +123,385 @@ namespace rpnx
     asn_counter& operator = (asn_counter const &)=default;
   };
 
+  /*
+    Thrown by the bounds checked deserialize(out, begin, end) when the input is truncated or malformed.
+  */
+  class deserialize_error
+    : public std::runtime_error
+  {
+  public:
+    explicit deserialize_error(char const * what)
+      : std::runtime_error(what)
+    {
+    }
+  };
+
+  /*
+    Throws unless at least n bytes remain in [in, end).
+  */
+  inline void check_remaining(uint8_t const * in, uint8_t const * end, size_t n)
+  {
+    if (size_t(end - in) < n) throw deserialize_error("unexpected end of input");
+  }
+
+  /*
+    The most elements with a serial size of zero a checked decode accepts. Such elements take no input,
+    so their count can't be bounded by the bytes that remain.
+  */
+  constexpr size_t max_empty_elements = size_t(1) << 20;
+
+  /*
+    Throws unless count elements of stride bytes each fit in [in, end).
+  */
+  inline void check_count(uint8_t const * in, uint8_t const * end, size_t count, size_t stride)
+  {
+    if (stride == 0 ? count > max_empty_elements : count > size_t(end - in)/stride) throw deserialize_error("container count exceeds input");
+  }
+
+  /*
+    Returns true when the host stores integers in the same (little endian) byte order
+    that is used on the wire. When the byte order can't be determined this returns false,
+    which is always safe since it only disables the memcpy fast paths.
+  */
+  constexpr bool host_is_little_endian()
+  {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+#elif defined(_WIN32)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /*
+    Bit scanning helpers. Both return 64 when x is zero.
+  */
+  constexpr unsigned count_leading_zeros64(uint64_t x)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return x == 0 ? 64 : unsigned(__builtin_clzll(x));
+#else
+    unsigned n = 0;
+    while (n < 64 && !(x & (UINT64_C(1) << (63 - n)))) n++;
+    return n;
+#endif
+  }
+
+  constexpr unsigned count_trailing_zeros64(uint64_t x)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return x == 0 ? 64 : unsigned(__builtin_ctzll(x));
+#else
+    unsigned n = 0;
+    while (n < 64 && !(x & (UINT64_C(1) << n))) n++;
+    return n;
+#endif
+  }
+
+  /*
+    Loads 8 bytes from p as a little endian integer. p does not need to be aligned.
+  */
+  inline uint64_t load_le64(uint8_t const * p)
+  {
+    uint64_t w;
+    if (host_is_little_endian())
+      {
+        std::memcpy(&w, p, sizeof(w));
+        return w;
+      }
+    w = 0;
+    for (size_t i = 0; i < 8; i++)
+      {
+        w |= uint64_t(p[i]) << (8*i);
+      }
+    return w;
+  }
+
+  /*
+    Loads sizeof(T) bytes from p as a little endian integer of type T. p does not need to be aligned.
+  */
+  template <typename T>
+  inline T load_le(uint8_t const * p)
+  {
+    if (host_is_little_endian() && !std::is_same<T, bool>::value)
+      {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+      }
+    uintmax_t v = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+      {
+        v |= uintmax_t(p[i]) << (8*i);
+      }
+    return static_cast<T>(v);
+  }
+
+  /*
+    Stores v to p as sizeof(T) little endian bytes. p does not need to be aligned.
+    On big endian hosts the shifts below compile to a byte swap.
+  */
+  template <typename T>
+  inline void store_le(uint8_t * p, T v)
+  {
+    if (host_is_little_endian() && !std::is_same<T, bool>::value)
+      {
+        std::memcpy(p, &v, sizeof(T));
+        return;
+      }
+    uintmax_t u = static_cast<uintmax_t>(v);
+    for (size_t i = 0; i < sizeof(T); i++)
+      {
+        p[i] = static_cast<uint8_t>(u >> (8*i));
+      }
+  }
+
+  /*
+    Contiguous iterator helpers.
+
+    When value is true, acquire(it, n) returns a pointer to n contiguous bytes starting at it,
+    and advances it past those bytes. n must not be zero.
+  */
+  template <typename It>
+  struct contiguous_output_helper
+  {
+    static constexpr bool value = std::is_same<It, typename std::vector<uint8_t>::iterator>::value;
+
+    static uint8_t* acquire(It & it, size_t n)
+    {
+      uint8_t* p = &*it;
+      it += n;
+      return p;
+    }
+  };
+
+  template <>
+  struct contiguous_output_helper<uint8_t*>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t* acquire(uint8_t* & it, size_t n)
+    {
+      uint8_t* p = it;
+      it += n;
+      return p;
+    }
+  };
+
+  template <typename A>
+  struct contiguous_output_helper<std::back_insert_iterator<std::vector<uint8_t, A>>>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t* acquire(std::back_insert_iterator<std::vector<uint8_t, A>> & it, size_t n)
+    {
+      std::vector<uint8_t, A> & vec = *extract_container(it);
+      size_t old_size = vec.size();
+      vec.resize(old_size + n);
+      return vec.data() + old_size;
+    }
+  };
+
+  /*
+    The most bytes a single contiguous_output_helper<It>::acquire(out, n) asks for when writing a run of
+    variable length. Sinks that buffer a bounded amount (see serial_lz.hpp) specialize it, and longer
+    runs are written in pieces.
+  */
+  template <typename It>
+  struct output_chunk_helper
+  {
+    static size_t size(It const &)
+    {
+      return SIZE_MAX;
+    }
+  };
+
+  /*
+    Writes n raw bytes to out, with one memcpy per output chunk when out is contiguous.
+  */
+  template <typename It, bool B = contiguous_output_helper<It>::value>
+  struct byte_output_helper;
+
+  template <typename It>
+  struct byte_output_helper<It, false>
+  {
+    static It write(uint8_t const * src, size_t n, It out)
+    {
+      for (size_t i = 0; i < n; i++)
+        {
+          *out++ = src[i];
+        }
+      return out;
+    }
+  };
+
+  template <typename It>
+  struct byte_output_helper<It, true>
+  {
+    static It write(uint8_t const * src, size_t n, It out)
+    {
+      size_t chunk = output_chunk_helper<It>::size(out);
+      while (n != 0)
+        {
+          size_t k = n < chunk ? n : chunk;
+          std::memcpy(contiguous_output_helper<It>::acquire(out, k), src, k);
+          src += k;
+          n -= k;
+        }
+      return out;
+    }
+  };
+
+  /*
+    Writes n bytes that are part of the object being serialized, already in wire order.
+
+    Sinks that can point at the caller's memory instead of copying it (see serial_iovec.hpp) specialize
+    reference(out, src, n) to record the bytes and return true. They must stay valid until the output
+    has been written. The default returns false, and the bytes are copied.
+  */
+  template <typename It>
+  struct object_output_helper
+  {
+    static bool reference(It &, uint8_t const *, size_t)
+    {
+      return false;
+    }
+
+    static It write(uint8_t const * src, size_t n, It out)
+    {
+      if (object_output_helper<It>::reference(out, src, n)) return out;
+      return byte_output_helper<It>::write(src, n, out);
+    }
+  };
+
+  template <typename It>
+  struct contiguous_input_helper
+  {
+    static constexpr bool value = std::is_same<It, typename std::vector<uint8_t>::iterator>::value
+      || std::is_same<It, typename std::vector<uint8_t>::const_iterator>::value;
+
+    static uint8_t const* acquire(It & it, size_t n)
+    {
+      uint8_t const* p = &*it;
+      it += n;
+      return p;
+    }
+  };
+
+  template <>
+  struct contiguous_input_helper<uint8_t*>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t const* acquire(uint8_t* & it, size_t n)
+    {
+      uint8_t const* p = it;
+      it += n;
+      return p;
+    }
+  };
+
+  template <>
+  struct contiguous_input_helper<uint8_t const*>
+  {
+    static constexpr bool value = true;
+
+    static uint8_t const* acquire(uint8_t const* & it, size_t n)
+    {
+      uint8_t const* p = it;
+      it += n;
+      return p;
+    }
+  };
+
+  /*
+    The most bytes a single contiguous_input_helper<It>::acquire(in, n) can hand out at the current
+    position. Sources that decode into a bounded buffer (see serial_lz.hpp) specialize it, and longer
+    runs are read in pieces.
+  */
+  template <typename It>
+  struct input_chunk_helper
+  {
+    static size_t size(It const &)
+    {
+      return SIZE_MAX;
+    }
+  };
+
+  /*
+    Reads n raw bytes from in to dest, with a single memcpy when in is contiguous.
+  */
+  template <typename It, bool B = contiguous_input_helper<It>::value>
+  struct byte_input_helper;
+
+  template <typename It>
+  struct byte_input_helper<It, false>
+  {
+    static It read(uint8_t * dest, size_t n, It in)
+    {
+      for (size_t i = 0; i < n; i++)
+        {
+          dest[i] = *in;
+          ++in;
+        }
+      return in;
+    }
+  };
+
+  template <typename It>
+  struct byte_input_helper<It, true>
+  {
+    static It read(uint8_t * dest, size_t n, It in)
+    {
+      if (n != 0) std::memcpy(dest, contiguous_input_helper<It>::acquire(in, n), n);
+      return in;
+    }
+  };
+
+
+
+  /*
+    Member lists.
+
+    Specializing serial_members<T> lets a plain struct be serialized without hand written serial_traits.
+    get() returns a std::tuple of pointers to the members of T, and T is then encoded exactly like the
+    tuple of those members, in the order listed. The specialization is normally written with
+    RPNX_SERIAL_MEMBERS at global scope, e.g.
+
+      struct quote { uint32_t id; uint64_t price; int16_t size; };
+      RPNX_SERIAL_MEMBERS(quote, &quote::id, &quote::price, &quote::size)
+  */
+  template <typename T>
+  struct serial_members;
+
+#define RPNX_SERIAL_MEMBERS(T, ...)                                     \
+  namespace rpnx                                                        \
+  {                                                                     \
+    template <>                                                         \
+    struct serial_members<T>                                            \
+    {                                                                   \
+      static constexpr auto get() -> decltype(std::make_tuple(__VA_ARGS__)) \
+      {                                                                 \
+        return std::make_tuple(__VA_ARGS__);                            \
+      }                                                                 \
+    };                                                                  \
+  }
+
+  template <typename T>
+  class has_serial_members_helper
+  {
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(serial_members<C>::get()) *);
+  public:
+    using type = decltype(test<T>(0));
+  };
 
+  template <typename T>
+  struct has_serial_members
+    : public has_serial_members_helper<T>::type
+  {
+  };
 
   /*
     Serial traits base cases.
@@ -108,6 +515,11 @@ namespace rpnx
     6 - string-like
     7 - reference
     8 - set-like
+    9 - optional
+    10 - variant
+    11 - struct with a member list (see serial_members)
+    12 - packed bit vector (std::vector<bool>)
+    13 - bitset
 
   */
   template <typename T>
@@ -118,6 +530,7 @@ namespace rpnx
     static constexpr int base_case()
     {
       if (std::is_const<T>::value || std::is_reference<T>::value) return 0;
+      if (has_serial_members<T>::value) return 11;
       if (std::is_integral<T>::value && std::is_unsigned<T>::value)
         {
           return 1;
@@ -141,6 +554,18 @@ namespace rpnx
     static constexpr int base_case() { return 3; }
   };
 
+  template <typename A>
+  struct serial_traits_base_cases<std::vector<bool, A> >
+  {
+    static constexpr int base_case() { return 12; }
+  };
+
+  template <size_t N>
+  struct serial_traits_base_cases<std::bitset<N> >
+  {
+    static constexpr int base_case() { return 13; }
+  };
+
   template <typename ... Ts>
   struct serial_traits_base_cases<std::tuple<Ts...>>
   {
@@ -184,6 +609,62 @@ namespace rpnx
     static constexpr int base_case() { return 5; }
   };
 
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::multimap<Ts...>>
+  {
+    static constexpr int base_case() { return 5; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::unordered_map<Ts...>>
+  {
+    static constexpr int base_case() { return 5; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::unordered_multimap<Ts...>>
+  {
+    static constexpr int base_case() { return 5; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::multiset<Ts...>>
+  {
+    static constexpr int base_case() { return 8; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::unordered_multiset<Ts...>>
+  {
+    static constexpr int base_case() { return 8; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::deque<Ts...>>
+  {
+    static constexpr int base_case() { return 3; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::list<Ts...>>
+  {
+    static constexpr int base_case() { return 3; }
+  };
+
+#if __cplusplus >= 201703L
+  template <typename T>
+  struct serial_traits_base_cases<std::optional<T>>
+  {
+    static constexpr int base_case() { return 9; }
+  };
+
+  template <typename ... Ts>
+  struct serial_traits_base_cases<std::variant<Ts...>>
+  {
+    static constexpr int base_case() { return 10; }
+  };
+#endif
+
   template <typename T>
   struct serial_traits_base_cases<T &>
   {
@@ -229,6 +710,10 @@ namespace rpnx
   };
 
 
+  /*
+    Fallback for user defined traits that have no better way to compute their size.
+    This runs a full serialize into an asn_counter, so the built in traits don't use it.
+  */
   template <typename T>
   struct serial_traits_defaults
   {
@@ -264,6 +749,75 @@ namespace rpnx
       return in;
     }
 
+    class async_deserializer
+    {
+      uint8_t a;
+      bool b;
+    public:
+      async_deserializer()
+        : a(0), b(false)
+      {
+      }
+
+      void reset()
+      {
+        a = 0;
+        b = false;
+      }
+
+      uint8_t get()
+      {
+        if (!ready()) __builtin_unreachable();
+        uint8_t t = a;
+        reset();
+        return t;
+      }
+
+      bool insert(uint8_t c)
+      {
+        a = c;
+        b = true;
+        return true;
+      }
+
+      template<typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (begin != end)
+          {
+            insert(*begin);
+            ++begin;
+          }
+        return {begin, ready()};
+      }
+
+      /** insert(3) Add a contiguous span of bytes to the deserializer
+          @precondition ready()==false
+          @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+      */
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      bool ready() const
+      {
+        return b;
+      }
+
+      size_t more_min() const
+      {
+        return b ? 0 : 1;
+      }
+
+      size_t more_max() const
+      {
+        return b ? 0 : 1;
+      }
+    };
+
   
     static void dev_test()  { std::cout << "serial_traits(uint8_t)" << std::endl; }
   };
@@ -271,63 +825,335 @@ namespace rpnx
 
 
 
+  /*
+    Writes the bytecount (at least 2) bytes of an encoded uintany: the first 8 from word, lowest byte
+    first, and the 9th and 10th, when present, from high. Contiguous outputs take them with a fixed
+    sequence of overlapping stores instead of a store per byte.
+  */
+  template <typename It, bool B = contiguous_output_helper<It>::value>
+  struct varint_output_helper;
+
+  template <typename It>
+  struct varint_output_helper<It, false>
+  {
+    static It write(uint64_t word, unsigned high, size_t bytecount, It out)
+    {
+      size_t low_bytes = bytecount < 8 ? bytecount : 8;
+      for (size_t i = 0; i < low_bytes; i++)
+        {
+          *out++ = uint8_t(word >> (8*i));
+        }
+      for (size_t i = 8; i < bytecount; i++)
+        {
+          *out++ = uint8_t(high >> (8*(i - 8)));
+        }
+      return out;
+    }
+  };
+
+  template <typename It>
+  struct varint_output_helper<It, true>
+  {
+    static It write(uint64_t word, unsigned high, size_t bytecount, It out)
+    {
+      uint8_t bytes[16];
+      store_le<uint64_t>(bytes, word);
+      store_le<uint64_t>(bytes + 8, uint64_t(high));
+      uint8_t * p = contiguous_output_helper<It>::acquire(out, bytecount);
+      // Five overlapping two byte copies, each clamped to end at the last byte, cover any length from 2
+      // to 10 without branching on it. Random lengths would mispredict almost every branch.
+      size_t last = bytecount - 2;
+      for (size_t i = 0; i < 10; i += 2)
+        {
+          size_t at = i < last ? i : last;
+          std::memcpy(p + at, bytes + at, 2);
+        }
+      return out;
+    }
+  };
+
+  /*
+    Reads one encoded uintany without bounds checks. Summing the raw bytes, continuation bits included,
+    gives the value with its bias already added: the continuation bit of byte k is worth 2^(7(k+1)), the
+    bias term for every length past k+1.
+
+    The end of the input isn't known here, so nothing past the value may be read and a whole word load is
+    never safe. Contiguous inputs instead tell a two byte value from a three byte one without a branch:
+    the third read is of byte 2 when byte 1 continues and of byte 1 again when it doesn't. That needs
+    random access to the bytes themselves, which block sources such as lz_input_iterator don't give.
+  */
+  template <typename It, bool B = contiguous_input_helper<It>::value
+    && std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category>::value
+    && std::is_lvalue_reference<typename std::iterator_traits<It>::reference>::value>
+  struct varint_input_helper;
+
+  template <typename It>
+  struct varint_input_helper<It, false>
+  {
+    static It read(uintmax_t & n, It in)
+    {
+      n = 0;
+      for (size_t shift = 0; shift < 64; shift += 7)
+        {
+          uint8_t a = *in++;
+          n += uintmax_t(a) << shift;
+          if (!(a & 0x80)) break;
+        }
+      return in;
+    }
+  };
+
+  template <typename It>
+  struct varint_input_helper<It, true>
+  {
+    static It read(uintmax_t & n, It in)
+    {
+      uint8_t const * p = &*in;
+      uint8_t a = p[0];
+      n = a;
+      if (!(a & 0x80))
+        {
+          return ++in;
+        }
+      uint8_t b = p[1];
+      size_t more = b >> 7;
+      uint8_t c = p[1 + more];
+      n += (uintmax_t(b) << 7) + ((uintmax_t(c) << 14) & (0 - uintmax_t(more)));
+      size_t len = 2 + more;
+      if (more & (c >> 7))
+        {
+          for (size_t shift = 21; shift < 64; shift += 7)
+            {
+              a = p[len++];
+              n += uintmax_t(a) << shift;
+              if (!(a & 0x80)) break;
+            }
+        }
+      in += len;
+      return in;
+    }
+  };
+
   template <>
   struct serial_traits<uintany, 0>
   {
  
 
-    template <typename It>
-    static constexpr auto serialize (uintmax_t const & in, It out) -> It
+  private:
+    /*
+      Number of values that encode in n bytes or fewer (n <= 9).
+      This is 2^7 + 2^14 + ... + 2^(7n), the bias subtracted from values that encode in n+1 bytes.
+    */
+    static constexpr uint64_t bias(size_t n)
     {
-      uintmax_t base = in;
+      return (UINT64_C(0x8102040810204081) & ((UINT64_C(1) << (7*n)) - 1)) << 7;
+    }
+
+    /*
+      Packs the low 7 bits of each byte of x into the low 56 bits of the result.
+    */
+    static inline uint64_t compact7(uint64_t x)
+    {
+#if defined(__BMI2__)
+      return _pext_u64(x, UINT64_C(0x7f7f7f7f7f7f7f7f));
+#else
+      x &= UINT64_C(0x7f7f7f7f7f7f7f7f);
+      x = (x & UINT64_C(0x007f007f007f007f)) | ((x & UINT64_C(0x7f007f007f007f00)) >> 1);
+      x = (x & UINT64_C(0x00003fff00003fff)) | ((x & UINT64_C(0x3fff00003fff0000)) >> 2);
+      x = (x & UINT64_C(0x000000000fffffff)) | ((x & UINT64_C(0x0fffffff00000000)) >> 4);
+      return x;
+#endif
+    }
 
-      uintmax_t bytecount = 1;
-      uintmax_t max = 0;
+    /*
+      Spreads the low 56 bits of x into the low 7 bits of each byte of the result.
+    */
+    static inline uint64_t spread7(uint64_t x)
+    {
+#if defined(__BMI2__)
+      return _pdep_u64(x, UINT64_C(0x7f7f7f7f7f7f7f7f));
+#else
+      x = (x & UINT64_C(0x000000000fffffff)) | ((x & UINT64_C(0x00fffffff0000000)) << 4);
+      x = (x & UINT64_C(0x00003fff00003fff)) | ((x & UINT64_C(0x0fffc0000fffc000)) << 2);
+      x = (x & UINT64_C(0x007f007f007f007f)) | ((x & UINT64_C(0x3f803f803f803f80)) << 1);
+      return x;
+#endif
+    }
 
-      max = (1ull << (7))-1;
-      while (base > max)
-        {
-          bytecount++;
-          base -= max+1;
-          max = (1ull << ((7)*bytecount))-1;     
-        }
-    
-      for (uintmax_t i = 0; i < bytecount; i++)
+    /*
+      Decodes one value starting at p, where at least 8 bytes must be readable.
+      Bytes past the first 8 are only read when they belong to the value. Returns the encoded length.
+    */
+    static inline size_t decode_word(uint8_t const * p, uintmax_t & n)
+    {
+      uint64_t w = load_le64(p);
+      uint64_t stops = ~w & UINT64_C(0x8080808080808080);
+      if (stops == 0)
         {
-          uint8_t val = base & ((uintmax_t(1) << (7)) -1);
-          if (i != bytecount-1)
+          n = compact7(w) | (uint64_t(p[8] & 0x7f) << 56);
+          if (!(p[8] & 0x80))
             {
-              val |= 0b10000000;
+              n += bias(8);
+              return 9;
             }
-          *out++ = val;
-          base >>= 7;
+          n |= uint64_t(p[9]) << 63;
+          n += bias(9);
+          return 10;
         }
-      return out;   
-    
+      size_t bytecount = count_trailing_zeros64(stops)/8 + 1;
+      n = compact7(w & (stops ^ (stops - 1))) + bias(bytecount - 1);
+      return bytecount;
+    }
+
+  public:
+
+    /*
+      Returns the number of bytes used to encode n.
+    */
+    static constexpr size_t encoded_size(uintmax_t n)
+    {
+      size_t groups = (70 - count_leading_zeros64(n | 1))/7;
+      return groups - (n < bias(groups - 1) ? 1 : 0);
+    }
+
+    template <typename It>
+    static constexpr auto serialize (uintmax_t const & in, It out) -> It
+    {
+      if (in < 0x80)
+        {
+          *out++ = uint8_t(in);
+          return out;
+        }
+
+      size_t bytecount = encoded_size(in);
+      uint64_t base = in - bias(bytecount - 1);
+
+      // Continuation bits for every byte but the last, split into two shifts so bytecount-1 >= 8 is defined.
+      uint64_t stop_mask = ~uint64_t(0) << (4*(bytecount - 1)) << (4*(bytecount - 1));
+      uint64_t word = spread7(base) | (UINT64_C(0x8080808080808080) & ~stop_mask);
+
+      unsigned high = unsigned((base >> 56) & 0x7f) | (bytecount > 9 ? 0x80 | unsigned(base >> 63) << 8 : 0);
+      return varint_output_helper<It>::write(word, high, bytecount, out);
     }
 
     template <typename It>
     static constexpr auto deserialize(uintmax_t  & n, It in ) -> It
     {
-      n = 0;
-      uintmax_t n2 = 0;
+      return varint_input_helper<It>::read(n, in);
+    }
 
+    /*
+      Bounds checked decode of one value from [in, end).
+      Throws deserialize_error if the value runs past end or does not fit in uintmax_t.
+    */
+    static uint8_t const * deserialize(uintmax_t & n, uint8_t const * in, uint8_t const * end)
+    {
+      if (in != end && *in < 0x80)
+        {
+          n = *in;
+          return in + 1;
+        }
+      if (size_t(end - in) >= encoded_size(UINTMAX_MAX))
+        {
+          // Values shorter than the maximum length can't overflow. Full length values are accepted here
+          // when the last byte holds a single bit and adding the bias didn't wrap; the loop below throws otherwise.
+          size_t len = decode_word(in, n);
+          if (len < encoded_size(UINTMAX_MAX) || (in[len - 1] <= 1 && n >= bias(len - 1))) return in + len;
+        }
 
+      n = 0;
+      size_t n2 = 0;
       while (true)
         {
+          if (in == end) throw deserialize_error("unexpected end of input");
           uint8_t a = *in++;
+          if (n2 == encoded_size(UINTMAX_MAX) - 1 && a > 1) throw deserialize_error("varint out of range");
 
-          uint8_t read_value = a & 0b1111111;
-
-          n += (uintmax_t(read_value) << (n2*7));
+          n += (uintmax_t(a & 0b1111111) << (n2*7));
 
           if (!(a&0b10000000)) break;
           n2++;
         }
 
-      for (uintmax_t i = 1; i <= n2; i++)
+      if (n + bias(n2) < n) throw deserialize_error("varint out of range");
+      n += bias(n2);
+      return in;
+    }
+
+    /*
+      Decodes count consecutive values starting at in, and returns a pointer past the last byte read.
+
+      Never reads past the end of the encoded values: since every value is at least one byte long,
+      the wide loads are only used while at least as many values remain as bytes are loaded.
+    */
+    static uint8_t const * decode_n(uint8_t const * in, size_t count, uintmax_t * out)
+    {
+      size_t i = 0;
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+#if defined(__AVX2__)
+      constexpr size_t block = 32;
+#else
+      constexpr size_t block = 16;
+#endif
+      while (count - i >= block)
+        {
+#if defined(__AVX2__)
+          __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(in));
+          uint64_t more = uint32_t(_mm256_movemask_epi8(bytes));
+#else
+          __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in));
+          uint64_t more = uint32_t(_mm_movemask_epi8(bytes));
+#endif
+          if (more == 0)
+            {
+              // Every byte in the block is a complete single byte value.
+              for (size_t j = 0; j < block; j += 4)
+                {
+                  uint32_t four;
+                  std::memcpy(&four, in + j, 4);
+#if defined(__AVX2__)
+                  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + j), _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(int(four))));
+#else
+                  __m128i v = _mm_cvtsi32_si128(int(four));
+                  _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + j), _mm_cvtepu8_epi64(v));
+                  _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + j + 2), _mm_cvtepu8_epi64(_mm_srli_epi32(v, 16)));
+#endif
+                }
+              in += block;
+              i += block;
+              continue;
+            }
+
+          // Since every value takes at least one byte, word loads from in are safe while 8 or more values remain.
+          // Single byte values are copied straight from the block, which keeps mostly small inputs fast.
+          size_t pos = 0;
+          while (pos < block && count - i >= 8)
+            {
+              if (!((more >> pos) & 1))
+                {
+                  out[i++] = in[pos++];
+                  continue;
+                }
+              pos += decode_word(in + pos, out[i++]);
+            }
+          in += pos;
+        }
+#endif
+
+      while (count - i >= 8)
+        {
+          if (!(*in & 0x80))
+            {
+              out[i++] = *in++;
+              continue;
+            }
+          in += decode_word(in, out[i++]);
+        }
+
+      for (; i < count; i++)
         {
-          n += (uintmax_t(1) << (i*7));
+          in = deserialize(out[i], in);
         }
       return in;
     }
@@ -374,10 +1200,7 @@ namespace rpnx
         bool more = a&0b10000000;
         if (!more) 
           {
-            for (uintmax_t i = 1; i <= n2; i++)
-              {
-                n1 += (uintmax_t(1) << (i*7));
-              }
+            n1 += bias(n2);
             b1 = true;
             return true;
           }
@@ -394,7 +1217,7 @@ namespace rpnx
           (Note: If .second is false then .first always equals the end iterator, this function will always consume as many bytes as possible unless an exception occurs)
       */
       template<typename It>
-      auto insert(It begin, It end) -> It
+      auto insert(It begin, It end) -> std::pair<It, bool>
       {
         if (ready()) __builtin_unreachable();
         auto it = begin;
@@ -407,6 +1230,32 @@ namespace rpnx
         return {it, ready()};
       }
 
+      /** insert(2) for contiguous bytes
+          When a whole value of the maximum encoded length is available, the value is decoded with a single word load.
+      */
+      auto insert(uint8_t const * begin, uint8_t const * end) -> std::pair<uint8_t const *, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (n2 == 0 && size_t(end - begin) >= encoded_size(UINTMAX_MAX))
+          {
+            begin += decode_word(begin, n1);
+            b1 = true;
+            return {begin, true};
+          }
+        while (begin != end && !insert(*begin++));
+        return {begin, ready()};
+      }
+
+      /** insert(3) Add a contiguous span of bytes to the deserializer
+          @precondition ready()==false
+          @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+      */
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
       /** Returns the output
           If ready()==false when this function is called, the behavior is undefined.
           If this function is called twice, the behavior is undefined.
@@ -434,19 +1283,15 @@ namespace rpnx
        */
       size_t more_max() const
       {
-        return SIZE_MAX;
+        return encoded_size(UINTMAX_MAX) - n2;
       }
   
 
     };
 
-    static size_t serial_size(size_t const & t)
+    static constexpr size_t serial_size(uintmax_t const & t)
     {
-      asn_counter iterator;
-
-      iterator = serialize(t, iterator);
-
-      return iterator.count;
+      return encoded_size(t);
     }
 
   };
@@ -512,7 +1357,7 @@ namespace rpnx
         return utoi(a.get());
       }
 
-      bool ready()
+      bool ready() const
       {
         return a.ready();
       }
@@ -528,6 +1373,11 @@ namespace rpnx
         return a.insert(b, e);
       }
 
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        return a.insert(data, n);
+      }
+
       bool insert(uint8_t c)
       {
         return a.insert(c);
@@ -566,63 +1416,183 @@ namespace rpnx
       return in;
     }
 
-    static size_t serial_size(size_t const & t)
+    static uint8_t const * deserialize(ssize_t & n, uint8_t const * in, uint8_t const * end)
+    {
+      uintmax_t v = 0;
+      in = serial_traits<uintany>::deserialize(v, in, end);
+      n = utoi(v);
+      return in;
+    }
+
+    static size_t serial_size(ssize_t const & t)
     {
-      asn_counter iterator;
+      return serial_traits<uintany>::encoded_size(itou(t));
+    }
+
+  };
+
 
-      iterator = serialize(t, iterator);
+  /*
+    Fused fixed size codec.
+
+    value is true for types whose encoding is a fixed run of fixed width little endian integers:
+    integral types, and tuples, pairs and arrays built only from such types. For these the layout is
+    known at compile time, so encode() and decode() store and load every field at a constant offset
+    of one size() byte block rather than streaming the value through the iterator a byte at a time.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case()>
+  struct fused_codec_helper
+  {
+    static constexpr bool value = false;
+  };
+
+  template <typename T>
+  struct fused_codec_helper<T const, 0>
+    : public fused_codec_helper<T>
+  {
+  };
+
+  template <typename T>
+  struct fused_integral_codec
+  {
+    static constexpr bool value = true;
+
+    static constexpr size_t size() { return sizeof(T); }
 
-      return iterator.count;
+    static void encode(T const & in, uint8_t * p)
+    {
+      store_le<T>(p, in);
     }
 
+    static void decode(T & out, uint8_t const * p)
+    {
+      out = load_le<T>(p);
+    }
   };
 
+  template <typename T>
+  struct fused_codec_helper<T, 1>
+    : public fused_integral_codec<T>
+  {
+  };
 
   template <typename T>
-  struct serial_traits<T,1>
+  struct fused_codec_helper<T, 2>
+    : public fused_integral_codec<T>
   {
-    static constexpr size_t serial_size(T const &) { return sizeof(T); }
-    static constexpr size_t serial_size() { return sizeof(T); }
-    static constexpr bool serial_size_constexpr() { return true; }
+  };
 
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
+  /*
+    Fixed size block helpers.
+
+    write<F>(in, out) encodes in with the fused codec F as one F::size() byte block, and read<F>(out, in)
+    decodes one. Contiguous iterators hand out the block in place, other iterators go through a
+    buffer on the stack.
+  */
+  template <typename It, bool B = contiguous_output_helper<It>::value>
+  struct block_output_helper;
+
+  template <typename It>
+  struct block_output_helper<It, true>
+  {
+    template <typename F, typename T>
+    static It write(T const & in, It out)
     {
-      T tm = in;
-      for (size_t i = 0; i < serial_size(); i++)
+      if (F::size() == 0)
         {
-          out = serial_traits<uint8_t>::serialize(tm & 0xFF, out);
-          tm >>= 8;
+          // Nothing to acquire, and out may be an end iterator.
+          uint8_t none = 0;
+          F::encode(in, &none);
+          return out;
         }
+      F::encode(in, contiguous_output_helper<It>::acquire(out, F::size()));
       return out;
     }
+  };
 
-    template <typename It>
-    static constexpr auto deserialize(T & out, It in) -> It
+  template <typename It>
+  struct block_output_helper<It, false>
+  {
+    template <typename F, typename T>
+    static It write(T const & in, It out)
+    {
+      uint8_t buf[F::size()];
+      F::encode(in, buf);
+      return byte_output_helper<It>::write(buf, F::size(), out);
+    }
+  };
+
+  template <typename It, bool B = contiguous_input_helper<It>::value>
+  struct block_input_helper;
+
+  template <typename It>
+  struct block_input_helper<It, true>
+  {
+    template <typename F, typename T>
+    static It read(T & out, It in)
     {
-      out = 0;
-      for (size_t i = 0; i < serial_size(); i++)
+      if (F::size() == 0)
+        {
+          // Nothing to acquire, and in may be an end iterator.
+          uint8_t const none = 0;
+          F::decode(out, &none);
+          return in;
+        }
+      if (input_chunk_helper<It>::size(in) < F::size())
         {
-          uint8_t value = 0;
-          in = serial_traits<uint8_t>::deserialize(value, in);
-          out |= (T(value) << (8*i));
+          return block_input_helper<It, false>::template read<F>(out, in);
         }
+      F::decode(out, contiguous_input_helper<It>::acquire(in, F::size()));
       return in;
     }
+  };
 
-    class async_deserializer
+  template <typename It>
+  struct block_input_helper<It, false>
+  {
+    template <typename F, typename T>
+    static It read(T & out, It in)
     {
-      T a;
-      size_t i;
-    public:
-      async_deserializer()
-      {
-        reset();
-      }
+      uint8_t buf[F::size()];
+      in = byte_input_helper<It>::read(buf, F::size(), in);
+      F::decode(out, buf);
+      return in;
+    }
+  };
 
-      void reset()
-      {
-        a = 0;
+
+  template <typename T>
+  struct serial_traits<T,1>
+  {
+    static constexpr size_t serial_size(T const &) { return sizeof(T); }
+    static constexpr size_t serial_size() { return sizeof(T); }
+    static constexpr bool serial_size_constexpr() { return true; }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return block_output_helper<It>::template write<fused_codec_helper<T>>(in, out);
+    }
+
+    template <typename It>
+    static constexpr auto deserialize(T & out, It in) -> It
+    {
+      return block_input_helper<It>::template read<fused_codec_helper<T>>(out, in);
+    }
+
+    class async_deserializer
+    {
+      T a;
+      size_t i;
+    public:
+      async_deserializer()
+      {
+        reset();
+      }
+
+      void reset()
+      {
+        a = 0;
         i = 0;
       }
 
@@ -642,7 +1612,7 @@ namespace rpnx
       }
   
       template<typename It>
-                         auto insert(It begin, It end) -> It
+      auto insert(It begin, It end) -> std::pair<It, bool>
       {
         auto it = begin;
         while (it != end && !ready())
@@ -652,13 +1622,47 @@ namespace rpnx
           }
         return {it, ready()};
       }
-  
 
+      /** insert(2) for contiguous bytes
+          A value that is entirely present is loaded in one step.
+      */
+      auto insert(uint8_t const * begin, uint8_t const * end) -> std::pair<uint8_t const *, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (i == 0 && size_t(end - begin) >= serial_size())
+          {
+            a = load_le<T>(begin);
+            i = serial_size();
+            return {begin + serial_size(), true};
+          }
+        while (begin != end && !insert(*begin++));
+        return {begin, ready()};
+      }
+
+      /** insert(3) Add a contiguous span of bytes to the deserializer
+          @precondition ready()==false
+          @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+      */
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
   
       bool ready() const
       {
         return i==serial_size();
       }
+
+      size_t more_min() const
+      {
+        return serial_size() - i;
+      }
+
+      size_t more_max() const
+      {
+        return serial_size() - i;
+      }
     };
 
     static void dev_test()  { std::cout << "serial_traits(unsigned integral)" << std::endl; }
@@ -681,28 +1685,14 @@ namespace rpnx
     template <typename It>
     static auto serialize(T const & in, It out) -> It
     {
-      T tm = in;
-      for (size_t i = 0; i < serial_size(); i++)
-        {
-          out = serial_traits<uint8_t>::serialize(tm & 0xFF, out);
-          tm >>= 8;
-        }
-      return out;
+      return block_output_helper<It>::template write<fused_codec_helper<T>>(in, out);
     }
 
   
     template <typename It>
     static constexpr auto deserialize(T & out, It in) -> It
     {
-      out = 0;
-      for (size_t i = 0; i < serial_size(); i++)
-        {
-          uint8_t value = 0;
-          in = serial_traits<uint8_t>::deserialize(value, in);
-          out |= (value << (8*i));
-        }
-      return in;
-    
+      return block_input_helper<It>::template read<fused_codec_helper<T>>(out, in);
     }
 
     class async_deserializer
@@ -738,7 +1728,7 @@ namespace rpnx
       }
 
       template<typename It>
-                         auto insert(It begin, It end) -> It
+      auto insert(It begin, It end) -> std::pair<It, bool>
       {
         if (ready()) __builtin_unreachable();
         auto it = begin;
@@ -751,11 +1741,46 @@ namespace rpnx
         return {it, ready()};
       }
 
+      /** insert(2) for contiguous bytes
+          A value that is entirely present is loaded in one step.
+      */
+      auto insert(uint8_t const * begin, uint8_t const * end) -> std::pair<uint8_t const *, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (i == 0 && size_t(end - begin) >= serial_size())
+          {
+            a = load_le<T>(begin);
+            i = serial_size();
+            return {begin + serial_size(), true};
+          }
+        while (begin != end && !insert(*begin++));
+        return {begin, ready()};
+      }
+
+      /** insert(3) Add a contiguous span of bytes to the deserializer
+          @precondition ready()==false
+          @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+      */
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
       bool ready() const
       {
         return i==serial_size();
       }
-    
+
+      size_t more_min() const
+      {
+        return serial_size() - i;
+      }
+
+      size_t more_max() const
+      {
+        return serial_size() - i;
+      }
     };
   
 
@@ -794,469 +1819,5090 @@ namespace rpnx
   };
 
 
+  /*
+    value is true for containers whose elements are stored contiguously and exposed by data().
+  */
   template <typename T>
-  struct serial_traits<T, 3>
+  struct contiguous_container_helper
   {
-    static void dev_test()  { std::cout << "serial_traits(vector-like)" << std::endl; }
+    static constexpr bool value = false;
+  };
 
-    static constexpr bool serial_size_constexpr() { return false; }
+  template <typename ... Ts>
+  struct contiguous_container_helper<std::vector<Ts...>>
+  {
+    static constexpr bool value = !std::is_same<typename std::vector<Ts...>::value_type, bool>::value;
+  };
 
-    static size_t serial_size(T const & what)
+  template <typename ... Ts>
+  struct contiguous_container_helper<std::basic_string<Ts...>>
+  {
+    static constexpr bool value = true;
+  };
+
+  template <typename T>
+  struct is_std_deque : public std::false_type
+  {
+  };
+
+  template <typename ... Ts>
+  struct is_std_deque<std::deque<Ts...>> : public std::true_type
+  {
+  };
+
+  /*
+    Bulk element helper for vector-like containers.
+
+    element is true when each element of T is encoded as sizeof(value_type) bytes in little endian
+    order, so a run of elements can be converted with a single memcpy (or a byte swapping loop on
+    big endian hosts) instead of going through serial_traits<value_type> one element at a time.
+    value is true when, in addition, all the elements of T are one such run.
+  */
+  template <typename T>
+  struct bulk_element_helper
+  {
+    using value_type = typename T::value_type;
+    using unsigned_type = typename std::make_unsigned<typename std::conditional<std::is_integral<value_type>::value && !std::is_same<value_type, bool>::value, value_type, int>::type>::type;
+
+    static constexpr bool element = std::is_integral<value_type>::value && !std::is_same<value_type, bool>::value;
+    static constexpr bool value = element && contiguous_container_helper<T>::value;
+
+    static void encode(value_type const * in, size_t count, uint8_t * out)
     {
-      return vector_size_helper<T>::serial_size(what);
+      if (host_is_little_endian())
+        {
+          std::memcpy(out, in, count*sizeof(value_type));
+          return;
+        }
+      for (size_t i = 0; i < count; i++)
+        {
+          unsigned_type tm = static_cast<unsigned_type>(in[i]);
+          for (size_t j = 0; j < sizeof(value_type); j++)
+            {
+              *out++ = static_cast<uint8_t>(tm & 0xFF);
+              tm = static_cast<unsigned_type>(tm >> 8);
+            }
+        }
     }
 
-
+    /*
+      Encodes count elements to the contiguous output out, one output chunk at a time.
+    */
     template <typename It>
-    static auto serialize(T const & in, It out) -> It
+    static It write(value_type const * in, size_t count, It out)
     {
-      out = serial_traits<uintany>::serialize(in.size(), out);
-
-      for (auto it = begin(in); it != end(in); it++)
+      size_t chunk = output_chunk_helper<It>::size(out)/sizeof(value_type);
+      if (chunk == 0) chunk = 1;
+      while (count != 0)
         {
-          out = serial_traits<typename T::value_type>::serialize(*it, out);
+          size_t k = count < chunk ? count : chunk;
+          encode(in, k, contiguous_output_helper<It>::acquire(out, k*sizeof(value_type)));
+          in += k;
+          count -= k;
         }
-    
       return out;
     }
-  
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+
+    static void decode(uint8_t const * in, size_t count, value_type * out)
     {
-      size_t count;
-      in = serial_traits<uintany>::deserialize(count, in);
+      if (host_is_little_endian())
+        {
+          std::memcpy(out, in, count*sizeof(value_type));
+          return;
+        }
       for (size_t i = 0; i < count; i++)
         {
-          typename T::value_type t;
-          in = serial_traits<typename T::value_type>::deserialize(t, in);
-          out.push_back(std::move(t));
+          unsigned_type tm = 0;
+          for (size_t j = 0; j < sizeof(value_type); j++)
+            {
+              tm |= static_cast<unsigned_type>(unsigned_type(*in++) << (8*j));
+            }
+          out[i] = static_cast<value_type>(tm);
         }
-
-
-      return in;
     }
 
-    class async_deserializer
+    /*
+      Decodes count elements from the contiguous input in, one input chunk at a time. An element split
+      between chunks is copied out first.
+    */
+    template <typename It>
+    static It read(It in, size_t count, value_type * out)
     {
-      T out;
-      typename serial_traits<uintany>::async_deserializer szd;
-      typename serial_traits<typename T::value_type>::async_deserializer td;
-      size_t sz;
-      size_t i;
-    
-      int stage;
-    public:
-      void reset()
-      {
-        stage = 0;
-        sz = 0;
-        i = 0;
-        out = T();
-      }
+      while (count != 0)
+        {
+          size_t k = input_chunk_helper<It>::size(in)/sizeof(value_type);
+          if (k == 0)
+            {
+              uint8_t buf[sizeof(value_type)];
+              in = byte_input_helper<It>::read(buf, sizeof(value_type), in);
+              decode(buf, 1, out);
+              k = 1;
+            }
+          else
+            {
+              if (k > count) k = count;
+              decode(contiguous_input_helper<It>::acquire(in, k*sizeof(value_type)), k, out);
+            }
+          out += k;
+          count -= k;
+        }
+      return in;
+    }
+  };
 
-      bool ready() const
-      {
-        if (stage == 0) return false;
-        if (stage == 1 && i == sz) return true;
-      }
+  template <typename T, typename It, bool B = bulk_element_helper<T>::value && contiguous_output_helper<It>::value>
+  struct vector_serialize_helper;
 
-      bool insert(uint8_t c)
-      {
-        if (stage == 0)
-          {
-            szd.insert(c);
-            if (szd.ready())
-              {
-                sz = szd.get();
-                stage++;
-              }
-            return ready();
-          }
-        if (stage == 1)
-          {
-            if (td.insert(c))
-              {
-                i++;
-                td.reset();
-              }
-            return ready();
-          }
-      }
-    };
-  };
-  
-  template <typename T, bool S1 = has_noarg_serial_size<typename T::key_type>::value>
-  struct set_size_helper;
+  /*
+    Segment helper for std::deque.
 
-  template <typename T>
-  struct set_size_helper<T, false>
+    A deque stores its elements in fixed size blocks, so runs of bulk encodable elements that are
+    adjacent in memory are converted one run at a time. for_each_segment calls f(pointer, length)
+    for each run of count elements starting at first.
+  */
+  template <typename T, typename It>
+  struct deque_segment_helper
   {
-    static size_t serial_size(T const & what)
+    template <typename DIt, typename F>
+    static void for_each_segment(DIt first, size_t count, F && f)
     {
-      size_t sz = 0;
-      for (auto it = what.begin(); it != what.end(); it++)
+      while (count != 0)
         {
-          sz += serial_traits<typename T::value_type>::serial_size(*it);
+          auto * p = &*first;
+          size_t run = 1;
+          while (run < count && &first[run] == p + run) run++;
+          f(p, run);
+          first += run;
+          count -= run;
         }
-      return sz;
-    
     }
   };
 
-  template <typename T>
-  struct set_size_helper<T, true>
+  template <typename T, typename It, bool B = is_std_deque<T>::value && bulk_element_helper<T>::element && contiguous_output_helper<It>::value>
+  struct segment_serialize_helper;
+
+  template <typename T, typename It>
+  struct segment_serialize_helper<T, It, false>
   {
-    static size_t serial_size(T const & what)
+    static auto serialize_elements(T const & in, It out) -> It
     {
-      size_t sz = 0;
-      sz += serial_traits<typename T::value_type>::serial_size()*what.size();
-      return sz;    
+      for (auto it = begin(in); it != end(in); it++)
+        {
+          out = serial_traits<typename T::value_type>::serialize(*it, out);
+        }
+      return out;
     }
   };
 
-
-  template <typename T, bool S1 = has_noarg_serial_size<typename T::key_type>::value, bool S2 = has_noarg_serial_size<typename T::mapped_type>::value>
-  struct map_size_helper;
-
-  template <typename T>
-  struct map_size_helper<T, false, false>
+  template <typename T, typename It>
+  struct segment_serialize_helper<T, It, true>
   {
-    static size_t serial_size(T const & what)
+    static auto serialize_elements(T const & in, It out) -> It
     {
-      size_t sz = 0;
-      for (auto it = what.begin(); it != what.end(); it++)
+      using value_type = typename T::value_type;
+      deque_segment_helper<T, It>::for_each_segment(in.begin(), in.size(), [&](value_type const * p, size_t run)
         {
-          sz += serial_traits<typename T::key_type>::serial_size(it->first);
-          sz += serial_traits<typename T::mapped_type>::serial_size(it->second);
-        }
-      return sz;
-    
+          out = bulk_element_helper<T>::write(p, run, out);
+        });
+      return out;
     }
   };
 
-  template <typename T>
-  struct map_size_helper<T, true, false>
+  template <typename T, typename It>
+  struct vector_serialize_helper<T, It, false>
   {
-    static size_t serial_size(T const & what)
+    static auto serialize(T const & in, It out) -> It
     {
-      size_t sz = 0;
-    
-      sz += what.size()*serial_traits<typename T::key_type>::serial_size();
-      for (auto it = what.begin(); it != what.end(); it++)
-        {       
-          sz += serial_traits<typename T::mapped_type>::serial_size(it->second);
-        }
-
-      return sz;
+      out = serial_traits<uintany>::serialize(in.size(), out);
+      return segment_serialize_helper<T, It>::serialize_elements(in, out);
     }
   };
 
-  template <typename T>
-  struct map_size_helper<T, false, true>
+  template <typename T, typename It>
+  struct vector_serialize_helper<T, It, true>
   {
-    static size_t serial_size(T const & what)
+    static auto serialize(T const & in, It out) -> It
     {
-      size_t sz = 0;
-    
-      sz += what.size()*serial_traits<typename T::mapped_type>::serial_size();
-      for (auto it = what.begin(); it != what.end(); it++)
-        {       
-          sz += serial_traits<typename T::key_type>::serial_size(it->first);
+      out = serial_traits<uintany>::serialize(in.size(), out);
+
+      if (in.size() != 0)
+        {
+          size_t n = in.size()*sizeof(typename T::value_type);
+          // The elements are stored in wire order already when the host is little endian.
+          if ((host_is_little_endian() || sizeof(typename T::value_type) == 1) && object_output_helper<It>::reference(out, reinterpret_cast<uint8_t const *>(in.data()), n)) return out;
+          out = bulk_element_helper<T>::write(in.data(), in.size(), out);
         }
 
-      return sz;
+      return out;
     }
   };
 
+  template <typename T, typename It, bool B = bulk_element_helper<T>::value && contiguous_input_helper<It>::value>
+  struct vector_deserialize_helper;
+
+  template <typename T, int C = serial_traits_base_cases<T>::base_case(), bool F = has_noarg_serial_size<T>::value>
+  struct checked_deserialize_helper;
+
+  /*
+    Allocator aware element construction.
+
+    The temporaries that elements are decoded into before being inserted are made with the container's allocator
+    when it is a std::pmr::polymorphic_allocator, so the strings and containers nested in an element
+    allocate from the container's memory resource and are moved, not copied, into it. With any other
+    allocator they are default constructed.
+  */
+  template <typename E, typename A>
+  struct element_allocator_helper
+  {
+    static E make(A const &)
+    {
+      return E();
+    }
+  };
+
+#if defined(__cpp_lib_memory_resource)
+  template <typename E, typename A, int K = !std::uses_allocator<E, A>::value ? 0 : std::is_constructible<E, std::allocator_arg_t, A const &>::value ? 2 : 1>
+  struct pmr_element_helper
+  {
+    static E make(A const &)
+    {
+      return E();
+    }
+  };
+
+  template <typename E, typename A>
+  struct pmr_element_helper<E, A, 1>
+  {
+    static E make(A const & a)
+    {
+      return E(a);
+    }
+  };
+
+  template <typename E, typename A>
+  struct pmr_element_helper<E, A, 2>
+  {
+    static E make(A const & a)
+    {
+      return E(std::allocator_arg, a);
+    }
+  };
+
+  template <typename K, typename V, typename A>
+  struct pmr_element_helper<std::pair<K, V>, A, 0>
+  {
+    static std::pair<K, V> make(A const & a)
+    {
+      return std::pair<K, V>(pmr_element_helper<typename std::remove_const<K>::type, A>::make(a), pmr_element_helper<V, A>::make(a));
+    }
+  };
+
+  template <typename E, typename U>
+  struct element_allocator_helper<E, std::pmr::polymorphic_allocator<U>>
+    : public pmr_element_helper<E, std::pmr::polymorphic_allocator<U>>
+  {
+  };
+#endif
+
+  /*
+    Makes a temporary to decode an element of out into.
+  */
+  template <typename E, typename T>
+  E make_element(T const & out)
+  {
+    return element_allocator_helper<E, typename T::allocator_type>::make(out.get_allocator());
+  }
+
+  /*
+    Element decoding for vector-like containers.
+
+    The container is resized once for the decoded count and the elements are decoded in place, which
+    avoids regrowth and a temporary plus move per element. std::vector<bool> has no addressable elements,
+    so it reserves and appends instead.
+  */
+  template <typename T, bool B = !std::is_same<typename T::value_type, bool>::value>
+  struct vector_elements_helper;
+
   template <typename T>
-  struct map_size_helper<T, true, true>
+  struct vector_elements_helper<T, true>
+  {
+    template <typename It>
+    static auto deserialize(T & out, size_t count, It in) -> It
+    {
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      auto it = out.begin();
+      std::advance(it, old_size);
+      for (; it != out.end(); ++it)
+        {
+          in = serial_traits<typename T::value_type>::deserialize(*it, in);
+        }
+      return in;
+    }
+
+    static uint8_t const * deserialize(T & out, size_t count, uint8_t const * in, uint8_t const * end)
+    {
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      auto it = out.begin();
+      std::advance(it, old_size);
+      for (; it != out.end(); ++it)
+        {
+          in = checked_deserialize_helper<typename T::value_type>::deserialize(*it, in, end);
+        }
+      return in;
+    }
+  };
+
+  template <typename T>
+  struct vector_elements_helper<T, false>
+  {
+    template <typename It>
+    static auto deserialize(T & out, size_t count, It in) -> It
+    {
+      out.reserve(out.size() + count);
+      for (size_t i = 0; i < count; i++)
+        {
+          typename T::value_type t;
+          in = serial_traits<typename T::value_type>::deserialize(t, in);
+          out.push_back(std::move(t));
+        }
+      return in;
+    }
+
+    static uint8_t const * deserialize(T & out, size_t count, uint8_t const * in, uint8_t const * end)
+    {
+      out.reserve(out.size() + count);
+      for (size_t i = 0; i < count; i++)
+        {
+          typename T::value_type t;
+          in = checked_deserialize_helper<typename T::value_type>::deserialize(t, in, end);
+          out.push_back(std::move(t));
+        }
+      return in;
+    }
+  };
+
+  template <typename T, typename It, bool B = is_std_deque<T>::value && bulk_element_helper<T>::element && contiguous_input_helper<It>::value>
+  struct segment_deserialize_helper;
+
+  template <typename T, typename It>
+  struct segment_deserialize_helper<T, It, false>
+  {
+    static auto deserialize_elements(T & out, size_t count, It in) -> It
+    {
+      return vector_elements_helper<T>::deserialize(out, count, in);
+    }
+  };
+
+  template <typename T, typename It>
+  struct segment_deserialize_helper<T, It, true>
+  {
+    static auto deserialize_elements(T & out, size_t count, It in) -> It
+    {
+      using value_type = typename T::value_type;
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      deque_segment_helper<T, It>::for_each_segment(out.begin() + old_size, count, [&](value_type * p, size_t run)
+        {
+          in = bulk_element_helper<T>::read(in, run, p);
+        });
+      return in;
+    }
+  };
+
+  template <typename T, typename It>
+  struct vector_deserialize_helper<T, It, false>
+  {
+    static auto deserialize(T & out, It in) -> It
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return deserialize_elements(out, count, in);
+    }
+
+    static auto deserialize_elements(T & out, size_t count, It in) -> It
+    {
+      return segment_deserialize_helper<T, It>::deserialize_elements(out, count, in);
+    }
+  };
+
+  template <typename T, typename It>
+  struct vector_deserialize_helper<T, It, true>
+  {
+    static auto deserialize(T & out, It in) -> It
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return deserialize_elements(out, count, in);
+    }
+
+    static auto deserialize_elements(T & out, size_t count, It in) -> It
+    {
+      // Grown one input chunk at a time, so a bogus count from a block source fails at the end of the
+      // stream rather than allocating count elements.
+      size_t old_size = out.size();
+      while (count != 0)
+        {
+          size_t k = input_chunk_helper<It>::size(in)/sizeof(typename T::value_type);
+          if (k == 0) k = 1;
+          if (k > count) k = count;
+          out.resize(old_size + k);
+          in = bulk_element_helper<T>::read(in, k, &out[old_size]);
+          old_size += k;
+          count -= k;
+        }
+
+      return in;
+    }
+  };
+
+
+  /*
+    Saturating size arithmetic for the more_min()/more_max() hints, where SIZE_MAX means unbounded.
+  */
+  constexpr size_t saturating_add(size_t a, size_t b)
   {
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+  }
+
+  constexpr size_t saturating_mul(size_t a, size_t b)
+  {
+    return b != 0 && a > SIZE_MAX / b ? SIZE_MAX : a * b;
+  }
+
+  template <typename T>
+  class has_reserve_helper
+  {
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(std::declval<C &>().reserve(size_t())) *);
+  public:
+    using type = decltype(test<T>(0));
+  };
+
+  template <typename T, bool B = has_reserve_helper<T>::type::value>
+  struct reserve_helper;
+
+  template <typename T>
+  struct reserve_helper<T, false>
+  {
+    static void reserve(T &, size_t)
+    {
+    }
+  };
+
+  template <typename T>
+  struct reserve_helper<T, true>
+  {
+    static void reserve(T & out, size_t n)
+    {
+      out.reserve(n);
+    }
+  };
+
+  /*
+    Bulk element decoding for async container deserializers.
+
+    When the elements of a vector-like container are bulk encodable and the input is a contiguous span,
+    insert() appends as many whole elements as the span holds (up to remaining) with a single decode
+    and returns how many were appended. Otherwise it appends nothing.
+  */
+  template <typename T, typename E, typename It, bool B = bulk_element_helper<T>::value && std::is_same<E, typename T::value_type>::value && std::is_same<It, uint8_t const *>::value && serial_traits_base_cases<T>::base_case() == 3>
+  struct async_bulk_helper;
+
+  template <typename T, typename E, typename It>
+  struct async_bulk_helper<T, E, It, false>
+  {
+    static size_t insert(T &, size_t, It &, It)
+    {
+      return 0;
+    }
+  };
+
+  template <typename T, typename E, typename It>
+  struct async_bulk_helper<T, E, It, true>
+  {
+    static size_t insert(T & out, size_t remaining, uint8_t const * & begin, uint8_t const * end)
+    {
+      size_t count = size_t(end - begin)/sizeof(E);
+      if (count > remaining) count = remaining;
+      if (count != 0)
+        {
+          size_t old_size = out.size();
+          out.resize(old_size + count);
+          bulk_element_helper<T>::decode(begin, count, &out[old_size]);
+          begin += count*sizeof(E);
+        }
+      return count;
+    }
+  };
+
+  /*
+    Async deserializer for length prefixed containers.
+
+    Reads the uintany element count, then feeds bytes to the async deserializer of E and inserts
+    each completed element at the end of the container. The count comes off the wire before any of
+    the elements do, so the up front reservation is capped and larger containers grow as the data arrives.
+  */
+  template <typename T, typename E>
+  class container_async_deserializer
+  {
+    static constexpr size_t reserve_limit = 65536;
+
+    T out;
+    typename serial_traits<uintany>::async_deserializer szd;
+    typename serial_traits<E>::async_deserializer td;
+    size_t sz;
+    size_t i;
+    size_t elem_min;
+    size_t elem_max;
+    int stage;
+    bool partial;
+  public:
+    container_async_deserializer()
+    {
+      elem_min = td.more_min();
+      elem_max = td.more_max();
+      reset();
+    }
+
+    void reset()
+    {
+      stage = 0;
+      sz = 0;
+      i = 0;
+      partial = false;
+      out = T();
+      szd.reset();
+      td.reset();
+    }
+
+    bool ready() const
+    {
+      return stage == 1 && i == sz;
+    }
+
+    bool insert(uint8_t c)
+    {
+      return insert(&c, &c + 1).second;
+    }
+
+    template <typename It>
+    auto insert(It begin, It end) -> std::pair<It, bool>
+    {
+      if (ready()) __builtin_unreachable();
+      while (begin != end && !ready())
+        {
+          if (stage == 0)
+            {
+              auto r = szd.insert(begin, end);
+              begin = r.first;
+              if (r.second)
+                {
+                  sz = szd.get();
+                  reserve_helper<T>::reserve(out, sz < reserve_limit ? sz : reserve_limit);
+                  stage = 1;
+                }
+            }
+          else
+            {
+              if (!partial)
+                {
+                  i += async_bulk_helper<T, E, It>::insert(out, sz - i, begin, end);
+                  if (begin == end || ready()) break;
+                }
+              auto r = td.insert(begin, end);
+              begin = r.first;
+              partial = !r.second;
+              if (r.second)
+                {
+                  out.insert(out.end(), td.get());
+                  i++;
+                }
+            }
+        }
+      return {begin, ready()};
+    }
+
+    /** insert(3) Add a contiguous span of bytes to the deserializer
+        @precondition ready()==false
+        @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+    */
+    auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+    {
+      auto r = insert(data, data + n);
+      return {size_t(r.first - data), r.second};
+    }
+
+    /** Returns the output
+        If ready()==false when this function is called, the behavior is undefined.
+        The deserializer is reset afterwards.
+    */
+    T get()
+    {
+      if (!ready()) __builtin_unreachable();
+      T t = std::move(out);
+      reset();
+      return t;
+    }
+
+    size_t more_min() const
+    {
+      if (stage == 0) return szd.more_min();
+      if (ready()) return 0;
+      return saturating_add(td.more_min(), saturating_mul(sz - i - 1, elem_min));
+    }
+
+    size_t more_max() const
+    {
+      if (stage == 0) return SIZE_MAX;
+      if (ready()) return 0;
+      return saturating_add(td.more_max(), saturating_mul(sz - i - 1, elem_max));
+    }
+  };
+
+  template <typename T>
+  struct serial_traits<T, 3>
+  {
+    static void dev_test()  { std::cout << "serial_traits(vector-like)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
     static size_t serial_size(T const & what)
     {
-      size_t sz = 0;
-    
-      sz += what.size()*serial_traits<typename T::mapped_type>::serial_size();
-      sz += what.size()*serial_traits<typename T::key_type>::serial_size();
-      return sz;
+      return vector_size_helper<T>::serial_size(what);
+    }
+
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return vector_serialize_helper<T, It>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return vector_deserialize_helper<T, It>::deserialize(out, in);
+    }
+
+    using async_deserializer = container_async_deserializer<T, typename T::value_type>;
+  };
+
+  /*
+    Packed bit sequences.
+
+    std::vector<bool> is encoded as a uintany bit count followed by packed_bit_bytes(count) bytes that
+    hold the bits LSB first: bit i is bit i%8 of byte i/8, and the unused high bits of the last byte
+    are zero. std::bitset<N> is encoded the same way without the count, so its size is fixed.
+    Bits are converted 64 at a time.
+  */
+  constexpr size_t packed_bit_bytes(size_t bits)
+  {
+    return bits/8 + (bits%8 != 0);
+  }
+
+  template <typename T>
+  struct bit_vector_helper
+  {
+    /*
+      Writes the bits of in as packed_bit_bytes(in.size()) bytes.
+    */
+    template <typename It>
+    static It encode(T const & in, It out)
+    {
+      size_t n = in.size();
+      uint8_t buf[8];
+      auto it = in.begin();
+      for (size_t i = 0; i < n; i += 64)
+        {
+          size_t k = n - i < 64 ? n - i : 64;
+          uint64_t w = 0;
+          for (size_t j = 0; j < k; j++, ++it)
+            {
+              w |= uint64_t(bool(*it)) << j;
+            }
+          store_le<uint64_t>(buf, w);
+          out = byte_output_helper<It>::write(buf, packed_bit_bytes(k), out);
+        }
+      return out;
+    }
+
+    /*
+      Appends count bits read from in to out.
+    */
+    template <typename It>
+    static It decode(T & out, size_t count, It in)
+    {
+      size_t old_size = out.size();
+      out.resize(old_size + count);
+      auto it = out.begin() + old_size;
+      uint8_t buf[8];
+      for (size_t i = 0; i < count; i += 64)
+        {
+          size_t k = count - i < 64 ? count - i : 64;
+          std::memset(buf, 0, sizeof(buf));
+          in = byte_input_helper<It>::read(buf, packed_bit_bytes(k), in);
+          uint64_t w = load_le64(buf);
+          for (size_t j = 0; j < k; j++, ++it)
+            {
+              *it = bool((w >> j) & 1);
+            }
+        }
+      return in;
+    }
+  };
+
+  /*
+    Async deserializer for packed bit vectors. Reads the bit count, then unpacks each byte as it arrives.
+  */
+  template <typename T>
+  class bit_vector_async_deserializer
+  {
+    static constexpr size_t reserve_limit = size_t(1) << 20;
+
+    T out;
+    typename serial_traits<uintany>::async_deserializer szd;
+    size_t sz;
+    size_t i;
+    int stage;
+  public:
+    bit_vector_async_deserializer()
+    {
+      reset();
+    }
+
+    void reset()
+    {
+      stage = 0;
+      sz = 0;
+      i = 0;
+      out = T();
+      szd.reset();
+    }
+
+    bool ready() const
+    {
+      return stage == 1 && i == packed_bit_bytes(sz);
+    }
+
+    bool insert(uint8_t c)
+    {
+      return insert(&c, &c + 1).second;
+    }
+
+    template <typename It>
+    auto insert(It begin, It end) -> std::pair<It, bool>
+    {
+      if (ready()) __builtin_unreachable();
+      while (begin != end && !ready())
+        {
+          if (stage == 0)
+            {
+              auto r = szd.insert(begin, end);
+              begin = r.first;
+              if (r.second)
+                {
+                  sz = szd.get();
+                  out.reserve(sz < reserve_limit ? sz : reserve_limit);
+                  stage = 1;
+                }
+              continue;
+            }
+          uint8_t c = *begin;
+          ++begin;
+          size_t k = sz - 8*i < 8 ? sz - 8*i : 8;
+          for (size_t j = 0; j < k; j++)
+            {
+              out.push_back(bool((c >> j) & 1));
+            }
+          i++;
+        }
+      return {begin, ready()};
+    }
+
+    /** insert(3) Add a contiguous span of bytes to the deserializer
+        @precondition ready()==false
+        @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+    */
+    auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+    {
+      auto r = insert(data, data + n);
+      return {size_t(r.first - data), r.second};
+    }
+
+    T get()
+    {
+      if (!ready()) __builtin_unreachable();
+      T t = std::move(out);
+      reset();
+      return t;
+    }
+
+    size_t more_min() const
+    {
+      if (stage == 0) return szd.more_min();
+      return packed_bit_bytes(sz) - i;
+    }
+
+    size_t more_max() const
+    {
+      if (stage == 0) return SIZE_MAX;
+      return packed_bit_bytes(sz) - i;
+    }
+  };
+
+  template <typename T>
+  struct serial_traits<T, 12>
+  {
+    static void dev_test()  { std::cout << "serial_traits(bit vector)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(T const & what)
+    {
+      return serial_traits<uintany>::encoded_size(what.size()) + packed_bit_bytes(what.size());
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+      return bit_vector_helper<T>::encode(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return bit_vector_helper<T>::decode(out, count, in);
+    }
+
+    using async_deserializer = bit_vector_async_deserializer<T>;
+  };
+
+  /*
+    Fused codec for bitsets. Bitsets of up to 64 bits go through to_ullong(), larger ones are
+    packed into 64 bit words one bit at a time.
+  */
+  template <size_t N, bool W = (N <= 64)>
+  struct bitset_codec_helper;
+
+  template <size_t N>
+  struct bitset_codec_helper<N, true>
+  {
+    static constexpr bool value = N != 0;
+
+    static constexpr size_t size() { return packed_bit_bytes(N); }
+
+    static void encode(std::bitset<N> const & in, uint8_t * p)
+    {
+      uint8_t buf[8];
+      store_le<uint64_t>(buf, uint64_t(in.to_ullong()));
+      std::memcpy(p, buf, size());
+    }
+
+    static void decode(std::bitset<N> & out, uint8_t const * p)
+    {
+      uint8_t buf[8] = {};
+      std::memcpy(buf, p, size());
+      out = std::bitset<N>(static_cast<unsigned long long>(load_le64(buf)));
+    }
+  };
+
+  template <size_t N>
+  struct bitset_codec_helper<N, false>
+  {
+    static constexpr bool value = true;
+
+    static constexpr size_t size() { return packed_bit_bytes(N); }
+
+    static void encode(std::bitset<N> const & in, uint8_t * p)
+    {
+      uint8_t buf[8];
+      for (size_t i = 0; i < N; i += 64)
+        {
+          size_t k = N - i < 64 ? N - i : 64;
+          uint64_t w = 0;
+          for (size_t j = 0; j < k; j++)
+            {
+              w |= uint64_t(in[i+j]) << j;
+            }
+          store_le<uint64_t>(buf, w);
+          std::memcpy(p + i/8, buf, packed_bit_bytes(k));
+        }
+    }
+
+    static void decode(std::bitset<N> & out, uint8_t const * p)
+    {
+      uint8_t buf[8];
+      for (size_t i = 0; i < N; i += 64)
+        {
+          size_t k = N - i < 64 ? N - i : 64;
+          std::memset(buf, 0, sizeof(buf));
+          std::memcpy(buf, p + i/8, packed_bit_bytes(k));
+          uint64_t w = load_le64(buf);
+          for (size_t j = 0; j < k; j++)
+            {
+              out[i+j] = bool((w >> j) & 1);
+            }
+        }
+    }
+  };
+
+  template <size_t N>
+  struct fused_codec_helper<std::bitset<N>, 13>
+    : public bitset_codec_helper<N>
+  {
+  };
+
+  template <typename T>
+  struct serial_traits<T, 13>
+  {
+    static void dev_test()  { std::cout << "serial_traits(bitset)" << std::endl; }
+
+    static constexpr size_t serial_size(T const &) { return serial_size(); }
+    static constexpr size_t serial_size() { return fused_codec_helper<T>::size(); }
+    static constexpr bool serial_size_constexpr() { return true; }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return block_output_helper<It>::template write<fused_codec_helper<T>>(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return block_input_helper<It>::template read<fused_codec_helper<T>>(out, in);
+    }
+
+    /*
+      Collects the fixed number of bytes, then decodes them at once.
+    */
+    class async_deserializer
+    {
+      std::array<uint8_t, fused_codec_helper<T>::size()> buf;
+      size_t i;
+    public:
+      async_deserializer()
+        : i(0)
+      {
+      }
+
+      void reset()
+      {
+        i = 0;
+      }
+
+      bool ready() const
+      {
+        return i == buf.size();
+      }
+
+      bool insert(uint8_t c)
+      {
+        buf[i++] = c;
+        return ready();
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        while (begin != end && !ready())
+          {
+            buf[i++] = *begin;
+            ++begin;
+          }
+        return {begin, ready()};
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        T t;
+        fused_codec_helper<T>::decode(t, buf.data());
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        return buf.size() - i;
+      }
+
+      size_t more_max() const
+      {
+        return buf.size() - i;
+      }
+    };
+  };
+  
+  /*
+    Delta encoding.
+
+    delta_encoded<C> is a vector-like or set-like container of integers that is serialized as a uintany
+    count, then the first value, then the difference of each value to the one before it. The first
+    value is zigzag encoded (as intany does) when the element type is signed. Differences are plain
+    uintany for sets ordered by std::less, which never decrease, and zigzag encoded otherwise, so
+    sorted or nearly sorted values such as ids and timestamps take a byte or two each.
+  */
+  template <typename C>
+  class delta_encoded
+    : public C
+  {
+  public:
+    using C::C;
+
+    delta_encoded() = default;
+
+    delta_encoded(C const & c)
+      : C(c)
+    {
+    }
+
+    delta_encoded(C && c)
+      : C(std::move(c))
+    {
+    }
+  };
+
+  /*
+    Maps between two's complement and the zigzag form used by intany: 0, -1, 1, -2 ... become 0, 1, 2, 3 ...
+  */
+  constexpr uintmax_t zigzag_encode(uintmax_t d)
+  {
+    return (d << 1) ^ (uintmax_t(0) - (d >> 63));
+  }
+
+  constexpr uintmax_t zigzag_decode(uintmax_t v)
+  {
+    return (v >> 1) ^ (uintmax_t(0) - (v & 1));
+  }
+
+  /*
+    Inclusive prefix sum of v[0..n) on top of carry, modulo 2^64, in place. With zigzag set the
+    values are zigzag decoded first. Returns the last sum (carry when n is zero).
+  */
+  inline uintmax_t delta_prefix_sum(uintmax_t * v, size_t n, uintmax_t carry, bool zigzag)
+  {
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const one = _mm256_set1_epi64x(1);
+    __m256i c = _mm256_set1_epi64x(int64_t(carry));
+    for (; n - i >= 4; i += 4)
+      {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(v + i));
+        if (zigzag) x = _mm256_xor_si256(_mm256_srli_epi64(x, 1), _mm256_sub_epi64(zero, _mm256_and_si256(x, one)));
+        // [a b c d] + [0 a b c], then + [0 0 a a+b]
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+        x = _mm256_add_epi64(x, c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(v + i), x);
+        c = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+      }
+    if (i != 0) carry = v[i-1];
+#elif defined(__SSE4_1__)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const one = _mm_set1_epi64x(1);
+    __m128i c = _mm_set1_epi64x(int64_t(carry));
+    for (; n - i >= 2; i += 2)
+      {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(v + i));
+        if (zigzag) x = _mm_xor_si128(_mm_srli_epi64(x, 1), _mm_sub_epi64(zero, _mm_and_si128(x, one)));
+        x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi64(x, c);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), x);
+        c = _mm_unpackhi_epi64(x, x);
+      }
+    if (i != 0) carry = v[i-1];
+#endif
+    for (; i < n; i++)
+      {
+        carry += zigzag ? zigzag_decode(v[i]) : v[i];
+        v[i] = carry;
+      }
+    return carry;
+  }
+
+  template <typename T>
+  class delta_ascending_helper
+  {
+    template <typename D> static std::false_type test(...);
+    template <typename D> static std::integral_constant<bool, std::is_same<typename D::key_compare, std::less<typename D::key_type>>::value || std::is_same<typename D::key_compare, std::less<void>>::value> test(int);
+  public:
+    using type = decltype(test<T>(0));
+  };
+
+  template <typename T>
+  struct delta_helper
+  {
+    using value_type = typename T::value_type;
+
+    static_assert(std::is_integral<value_type>::value && !std::is_same<value_type, bool>::value, "delta_encoded requires an integral element type");
+
+    static constexpr bool ascending = delta_ascending_helper<T>::type::value;
+
+    /*
+      Returns the varint for the value u at position i, given the previous value prev.
+    */
+    static uintmax_t encode(uintmax_t u, uintmax_t prev, size_t i)
+    {
+      uintmax_t d = u - prev;
+      bool zigzag = i == 0 ? std::is_signed<value_type>::value : !ascending;
+      return zigzag ? zigzag_encode(d) : d;
+    }
+
+    /*
+      Returns the value at position i given its varint v and the previous value prev.
+    */
+    static uintmax_t decode(uintmax_t v, uintmax_t prev, size_t i)
+    {
+      bool zigzag = i == 0 ? std::is_signed<value_type>::value : !ascending;
+      return prev + (zigzag ? zigzag_decode(v) : v);
+    }
+
+    static void append(T & out, uintmax_t u)
+    {
+      out.insert(out.end(), static_cast<value_type>(u));
+    }
+  };
+
+  /*
+    Decoding of delta encoded values. From a pointer the varints are decoded in blocks with
+    uintany::decode_n and summed with delta_prefix_sum, other iterators decode one value at a time.
+  */
+  template <typename T, typename It, bool B = std::is_same<It, uint8_t const *>::value || std::is_same<It, uint8_t *>::value>
+  struct delta_decode_helper;
+
+  template <typename T, typename It>
+  struct delta_decode_helper<T, It, false>
+  {
+    static It deserialize(T & out, size_t count, It in)
+    {
+      uintmax_t prev = 0;
+      for (size_t i = 0; i < count; i++)
+        {
+          uintmax_t v;
+          in = serial_traits<uintany>::deserialize(v, in);
+          prev = delta_helper<T>::decode(v, prev, i);
+          delta_helper<T>::append(out, prev);
+        }
+      return in;
+    }
+  };
+
+  template <typename T, typename It>
+  struct delta_decode_helper<T, It, true>
+  {
+    static constexpr size_t block = 256;
+
+    static It deserialize(T & out, size_t count, It in)
+    {
+      uintmax_t buf[block];
+      uint8_t const * p = in;
+      uintmax_t prev = 0;
+      for (size_t i = 0; i < count; )
+        {
+          size_t k = count - i < block ? count - i : block;
+          p = serial_traits<uintany>::decode_n(p, k, buf);
+          if (i == 0)
+            {
+              buf[0] = delta_helper<T>::decode(buf[0], 0, 0);
+              prev = delta_prefix_sum(buf + 1, k - 1, buf[0], !delta_helper<T>::ascending);
+            }
+          else
+            {
+              prev = delta_prefix_sum(buf, k, prev, !delta_helper<T>::ascending);
+            }
+          for (size_t j = 0; j < k; j++)
+            {
+              delta_helper<T>::append(out, buf[j]);
+            }
+          i += k;
+        }
+      return in + (p - in);
+    }
+  };
+
+  template <typename C>
+  struct serial_traits<delta_encoded<C>, 0>
+  {
+    using T = delta_encoded<C>;
+
+    static void dev_test()  { std::cout << "serial_traits(delta encoded)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = serial_traits<uintany>::encoded_size(what.size());
+      uintmax_t prev = 0;
+      size_t i = 0;
+      for (auto const & x : what)
+        {
+          sz += serial_traits<uintany>::encoded_size(delta_helper<C>::encode(uintmax_t(x), prev, i++));
+          prev = uintmax_t(x);
+        }
+      return sz;
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+      uintmax_t prev = 0;
+      size_t i = 0;
+      for (auto const & x : in)
+        {
+          out = serial_traits<uintany>::serialize(delta_helper<C>::encode(uintmax_t(x), prev, i++), out);
+          prev = uintmax_t(x);
+        }
+      return out;
+    }
+
+    /*
+      Replaces the contents of out.
+    */
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      out.clear();
+      reserve_helper<C>::reserve(out, count);
+      return delta_decode_helper<C, It>::deserialize(out, count, in);
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      // Every value takes at least one byte.
+      if (count > size_t(end - in)) throw deserialize_error("container count exceeds input");
+      out.clear();
+      reserve_helper<C>::reserve(out, count);
+      uintmax_t prev = 0;
+      for (size_t i = 0; i < count; i++)
+        {
+          uintmax_t v;
+          in = serial_traits<uintany>::deserialize(v, in, end);
+          prev = delta_helper<C>::decode(v, prev, i);
+          delta_helper<C>::append(out, prev);
+        }
+      return in;
+    }
+
+    class async_deserializer
+    {
+      static constexpr size_t reserve_limit = 65536;
+
+      T out;
+      typename serial_traits<uintany>::async_deserializer ds;
+      size_t sz;
+      size_t i;
+      uintmax_t prev;
+      int stage;
+    public:
+      async_deserializer()
+      {
+        reset();
+      }
+
+      void reset()
+      {
+        out = T();
+        ds.reset();
+        sz = 0;
+        i = 0;
+        prev = 0;
+        stage = 0;
+      }
+
+      bool ready() const
+      {
+        return stage == 1 && i == sz;
+      }
+
+      bool insert(uint8_t c)
+      {
+        return insert(&c, &c + 1).second;
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        while (begin != end && !ready())
+          {
+            auto r = ds.insert(begin, end);
+            begin = r.first;
+            if (!r.second) break;
+            if (stage == 0)
+              {
+                sz = ds.get();
+                reserve_helper<C>::reserve(out, sz < reserve_limit ? sz : reserve_limit);
+                stage = 1;
+                continue;
+              }
+            prev = delta_helper<C>::decode(ds.get(), prev, i++);
+            delta_helper<C>::append(out, prev);
+          }
+        return {begin, ready()};
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        if (!ready()) __builtin_unreachable();
+        T t = std::move(out);
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        if (ready()) return 0;
+        return saturating_add(ds.more_min(), stage == 0 ? 0 : sz - i - 1);
+      }
+
+      size_t more_max() const
+      {
+        if (ready()) return 0;
+        if (stage == 0) return SIZE_MAX;
+        return saturating_add(ds.more_max(), saturating_mul(sz - i - 1, serial_traits<uintany>::encoded_size(UINTMAX_MAX)));
+      }
+    };
+  };
+
+  template <typename T, bool S1 = has_noarg_serial_size<typename T::key_type>::value>
+  struct set_size_helper;
+
+  template <typename T>
+  struct set_size_helper<T, false>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+      for (auto it = what.begin(); it != what.end(); it++)
+        {
+          sz += serial_traits<typename T::value_type>::serial_size(*it);
+        }
+      return sz;
+    
+    }
+  };
+
+  template <typename T>
+  struct set_size_helper<T, true>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+      sz += serial_traits<typename T::value_type>::serial_size()*what.size();
+      return sz;    
+    }
+  };
+
+
+  template <typename T, bool S1 = has_noarg_serial_size<typename T::key_type>::value, bool S2 = has_noarg_serial_size<typename T::mapped_type>::value>
+  struct map_size_helper;
+
+  template <typename T>
+  struct map_size_helper<T, false, false>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+      for (auto it = what.begin(); it != what.end(); it++)
+        {
+          sz += serial_traits<typename T::key_type>::serial_size(it->first);
+          sz += serial_traits<typename T::mapped_type>::serial_size(it->second);
+        }
+      return sz;
+    
+    }
+  };
+
+  template <typename T>
+  struct map_size_helper<T, true, false>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+    
+      sz += what.size()*serial_traits<typename T::key_type>::serial_size();
+      for (auto it = what.begin(); it != what.end(); it++)
+        {       
+          sz += serial_traits<typename T::mapped_type>::serial_size(it->second);
+        }
+
+      return sz;
+    }
+  };
+
+  template <typename T>
+  struct map_size_helper<T, false, true>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+    
+      sz += what.size()*serial_traits<typename T::mapped_type>::serial_size();
+      for (auto it = what.begin(); it != what.end(); it++)
+        {       
+          sz += serial_traits<typename T::key_type>::serial_size(it->first);
+        }
+
+      return sz;
+    }
+  };
+
+  template <typename T>
+  struct map_size_helper<T, true, true>
+  {
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = 0;
+    
+      sz += what.size()*serial_traits<typename T::mapped_type>::serial_size();
+      sz += what.size()*serial_traits<typename T::key_type>::serial_size();
+      return sz;
+
+    }
+  };
+
+  /*
+    Element insertion for set-like and map-like decoding.
+
+    Ordered containers are written in order, so each decoded element belongs at the end of out and is
+    inserted with emplace_hint(out.end(), ...), which is amortized O(1) instead of an O(log n) search.
+    The container checks the hint against its last element and searches as usual when the input turns
+    out not to be sorted, and unordered containers ignore it, so any input still decodes as it did with
+    insert(). Map values are decoded straight into the inserted node instead of through a std::pair
+    temporary; for a duplicate key the first value is kept, as insert() does.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case()>
+  struct element_insert_helper;
+
+  template <typename T>
+  struct element_insert_helper<T, 8>
+  {
+    using E = typename T::value_type;
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      E e = make_element<E>(out);
+      in = serial_traits<E>::deserialize(e, in);
+      out.emplace_hint(out.end(), std::move(e));
+      return in;
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      E e = make_element<E>(out);
+      in = checked_deserialize_helper<E>::deserialize(e, in, end);
+      out.emplace_hint(out.end(), std::move(e));
+      return in;
+    }
+  };
+
+  template <typename T>
+  struct element_insert_helper<T, 5>
+  {
+    using K = typename T::key_type;
+    using V = typename T::mapped_type;
+
+    // Inserts k with a default value and returns the value to decode into, or null for a duplicate key.
+    static V * emplace(T & out, K & k)
+    {
+      size_t n = out.size();
+      auto it = out.emplace_hint(out.end(), std::piecewise_construct, std::forward_as_tuple(std::move(k)), std::tuple<>());
+      return out.size() != n ? &it->second : nullptr;
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      K k = make_element<K>(out);
+      in = serial_traits<K>::deserialize(k, in);
+      V * v = emplace(out, k);
+      if (v != nullptr) return serial_traits<V>::deserialize(*v, in);
+      V dup = make_element<V>(out);
+      return serial_traits<V>::deserialize(dup, in);
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      K k = make_element<K>(out);
+      in = checked_deserialize_helper<K>::deserialize(k, in, end);
+      V * v = emplace(out, k);
+      if (v != nullptr) return checked_deserialize_helper<V>::deserialize(*v, in, end);
+      V dup = make_element<V>(out);
+      return checked_deserialize_helper<V>::deserialize(dup, in, end);
+    }
+  };
+
+  template <typename T>
+  struct serial_traits<T, 8>
+  {
+    static void dev_test()  { std::cout << "serial_traits(set)" << std::endl; }
+
+  private:
+
+  
+  public:
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = serial_traits<uintany>::serial_size(what.size());
+      sz += set_size_helper< T >::serial_size(what);
+      return sz;
+    }
+  
+    static constexpr bool serial_size_constexpr() { return false; }
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+
+      for (auto it = begin(in); it != end(in); it++)
+        {
+          out = serial_traits<typename T::value_type>::serialize(*it, out);
+        }
+    
+      return out;
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      out.clear();
+      size_t sz = 0;
+      in = serial_traits<uintany>::deserialize(sz, in);
+      reserve_helper<T>::reserve(out, sz);
+
+      for (size_t i = 0; i < sz; i++)
+        {
+          in = element_insert_helper<T>::deserialize(out, in);
+        }
+      return in;
+    }
+
+    using async_deserializer = container_async_deserializer<T, typename T::value_type>;
+  };
+
+
+
+  template <typename T>
+  struct serial_traits<T, 5>
+  {
+    static void dev_test()  { std::cout << "serial_traits(map)" << std::endl; }
+
+  private:
+
+  
+  public:
+    static size_t serial_size(T const & what)
+    {
+      size_t sz = serial_traits<uintany>::serial_size(what.size());
+      sz += map_size_helper< T >::serial_size(what);
+      return sz;
+    }
+  
+    static constexpr bool serial_size_constexpr() { return false; }
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+
+      for (auto it = begin(in); it != end(in); it++)
+        {
+          out = serial_traits<typename T::value_type>::serialize(*it, out);
+        }
+    
+      return out;
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      out.clear();
+      size_t sz = 0;
+      in = serial_traits<uintany>::deserialize(sz, in);
+      reserve_helper<T>::reserve(out, sz);
+
+      for (size_t i = 0; i < sz; i++)
+        {
+          in = element_insert_helper<T>::deserialize(out, in);
+        }
+      return in;
+    }
+
+    using async_deserializer = container_async_deserializer<T, std::pair<typename T::key_type, typename T::mapped_type>>;
+  };
+
+
+
+  template <template <typename> typename, typename>
+  class tuple_converter;
+
+  template <template <typename> typename Templ, typename ... Ts>
+  class tuple_converter< Templ,  std::tuple<Ts...> >
+  {
+  public:
+    using type = typename std::tuple<typename Templ<typename std::remove_reference<Ts>::type>::type...>;
+  };
+
+  template <template <typename> typename Templ, typename T1, typename T2>
+  class tuple_converter< Templ,  std::pair<T1, T2> >
+  {
+  public:
+    using type = typename std::pair<typename Templ<typename std::remove_reference<T1>::type>::type, typename Templ<typename std::remove_reference<T2>::type>::type>;
+  };
+
+  template <template <typename> typename Templ, typename T, size_t N>
+  class tuple_converter< Templ,  std::array<T, N> >
+  {
+  public:
+    using type = typename std::array<typename Templ<T>::type, N>;
+  };
+
+
+  template <typename T>
+  struct tuple_converter_type_helper
+  {
+    using type = typename serial_traits<T>::async_deserializer;
+  };
+
+  template <typename T, int I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
+  struct tuple_serial_traits;
+
+  template <typename T, int I>
+  struct tuple_serial_traits<T, I, true>
+  {
+    static constexpr bool serial_size_constexpr() 
+    {
+      return has_noarg_serial_size<typename std::tuple_element<I, T>::type>::value;
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type>::serial_size();
+    }
+
+    static size_t serial_size(T const & in)
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type>::serial_size(std::get<I>(in));
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type>::serialize(std::get<I>(in), out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type >::deserialize(std::get<I>(out), in);
+    }
+
+    template <typename D, typename It>
+    static auto async_insert(D & ds, T & out, size_t & index, It begin, It end) -> It
+    {
+      if (index != I || begin == end) return begin;
+      auto r = std::get<I>(ds).insert(begin, end);
+      if (r.second)
+        {
+          std::get<I>(out) = std::get<I>(ds).get();
+          index++;
+        }
+      return r.first;
+    }
+
+    template <typename D>
+    static void async_reset(D & ds)
+    {
+      std::get<I>(ds).reset();
+    }
+
+    template <typename D>
+    static size_t async_more_min(D const & ds, size_t index)
+    {
+      return index > I ? 0 : std::get<I>(ds).more_min();
+    }
+
+    template <typename D>
+    static size_t async_more_max(D const & ds, size_t index)
+    {
+      return index > I ? 0 : std::get<I>(ds).more_max();
+    }
+  };
+
+
+
+  template <typename T, int I>
+  struct tuple_serial_traits<T, I, false>
+  {
+    static constexpr bool serial_size_constexpr() 
+    {
+      return has_noarg_serial_size<typename std::tuple_element<I, T>::type>::value && tuple_serial_traits<T, I+1>::serial_size_constexpr();
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type>::serial_size() + tuple_serial_traits<T, I+1>::serial_size();
+    }
+
+    static size_t serial_size(T const & in)
+    {
+      return serial_traits<typename std::tuple_element<I, T>::type>::serial_size(std::get<I>(in)) + tuple_serial_traits<T, I+1>::serial_size(in);
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<typename std::tuple_element<I, T>::type>::serialize(std::get<I>(in), out);
+      return tuple_serial_traits<T, I+1>::serialize(in, out);
+    }
+  
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      in = serial_traits<typename std::tuple_element<I, T>::type>::deserialize(std::get<I>(out), in);
+      return tuple_serial_traits<T, I+1>::deserialize(out, in);
+    }
+
+    template <typename D, typename It>
+    static auto async_insert(D & ds, T & out, size_t & index, It begin, It end) -> It
+    {
+      if (index == I && begin != end)
+        {
+          auto r = std::get<I>(ds).insert(begin, end);
+          begin = r.first;
+          if (!r.second) return begin;
+          std::get<I>(out) = std::get<I>(ds).get();
+          index++;
+        }
+      return tuple_serial_traits<T, I+1>::async_insert(ds, out, index, begin, end);
+    }
+
+    template <typename D>
+    static void async_reset(D & ds)
+    {
+      std::get<I>(ds).reset();
+      tuple_serial_traits<T, I+1>::async_reset(ds);
+    }
+
+    template <typename D>
+    static size_t async_more_min(D const & ds, size_t index)
+    {
+      return saturating_add(index > I ? 0 : std::get<I>(ds).more_min(), tuple_serial_traits<T, I+1>::async_more_min(ds, index));
+    }
+
+    template <typename D>
+    static size_t async_more_max(D const & ds, size_t index)
+    {
+      return saturating_add(index > I ? 0 : std::get<I>(ds).more_max(), tuple_serial_traits<T, I+1>::async_more_max(ds, index));
+    }
+
+  };
+
+
+  /*
+    Fused codec for tuples and pairs whose elements are all fused. Element I is stored at the sum
+    of the sizes of the elements before it, which folds to a constant once the recursion is inlined.
+  */
+  template <typename T, size_t I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
+  struct fused_tuple_helper;
+
+  template <typename T, size_t I>
+  struct fused_tuple_helper<T, I, true>
+  {
+    using element_codec = fused_codec_helper<typename std::tuple_element<I, T>::type>;
+
+    static constexpr bool value = element_codec::value;
+
+    static constexpr size_t size() { return element_codec::size(); }
+
+    static void encode(T const & in, uint8_t * p)
+    {
+      element_codec::encode(std::get<I>(in), p);
+    }
+
+    static void decode(T & out, uint8_t const * p)
+    {
+      element_codec::decode(std::get<I>(out), p);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct fused_tuple_helper<T, I, false>
+  {
+    using element_codec = fused_codec_helper<typename std::tuple_element<I, T>::type>;
+
+    static constexpr bool value = element_codec::value && fused_tuple_helper<T, I+1>::value;
+
+    static constexpr size_t size() { return element_codec::size() + fused_tuple_helper<T, I+1>::size(); }
+
+    static void encode(T const & in, uint8_t * p)
+    {
+      element_codec::encode(std::get<I>(in), p);
+      fused_tuple_helper<T, I+1>::encode(in, p + element_codec::size());
+    }
+
+    static void decode(T & out, uint8_t const * p)
+    {
+      element_codec::decode(std::get<I>(out), p);
+      fused_tuple_helper<T, I+1>::decode(out, p + element_codec::size());
+    }
+  };
+
+  template <typename T>
+  struct fused_codec_helper<T, 4>
+    : public fused_tuple_helper<T>
+  {
+  };
+
+  /*
+    Fused codec for std::array. Arrays of integers are one bulk copy (a memcpy on little endian
+    hosts), arrays of other fused types are a loop over fixed size slots.
+  */
+  template <typename E, size_t N, bool B = bulk_element_helper<std::array<E, N>>::element>
+  struct fused_array_helper;
+
+  template <typename E, size_t N>
+  struct fused_array_helper<E, N, true>
+  {
+    static constexpr bool value = N != 0;
+
+    static constexpr size_t size() { return N*sizeof(E); }
+
+    static void encode(std::array<E, N> const & in, uint8_t * p)
+    {
+      bulk_element_helper<std::array<E, N>>::encode(in.data(), N, p);
+    }
+
+    static void decode(std::array<E, N> & out, uint8_t const * p)
+    {
+      bulk_element_helper<std::array<E, N>>::decode(p, N, out.data());
+    }
+  };
+
+  template <typename E, size_t N>
+  struct fused_array_helper<E, N, false>
+  {
+    using element_codec = fused_codec_helper<E>;
+
+    static constexpr bool value = N != 0 && element_codec::value;
+
+    static constexpr size_t size() { return N*element_codec::size(); }
+
+    static void encode(std::array<E, N> const & in, uint8_t * p)
+    {
+      for (size_t i = 0; i < N; i++)
+        {
+          element_codec::encode(in[i], p + i*element_codec::size());
+        }
+    }
+
+    static void decode(std::array<E, N> & out, uint8_t const * p)
+    {
+      for (size_t i = 0; i < N; i++)
+        {
+          element_codec::decode(out[i], p + i*element_codec::size());
+        }
+    }
+  };
+
+  template <typename E, size_t N>
+  struct fused_codec_helper<std::array<E, N>, 4>
+    : public fused_array_helper<E, N>
+  {
+  };
+
+  /*
+    Tuple codec helper. Tuples that are fused are written and read as a single block.
+  */
+  template <typename T, bool B = fused_codec_helper<T>::value>
+  struct tuple_codec_helper;
+
+  template <typename T>
+  struct tuple_codec_helper<T, false>
+  {
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return tuple_serial_traits<T>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return tuple_serial_traits<T>::deserialize(out, in);
+    }
+  };
+
+  template <typename T>
+  struct tuple_codec_helper<T, true>
+  {
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return block_output_helper<It>::template write<fused_codec_helper<T>>(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return block_input_helper<It>::template read<fused_codec_helper<T>>(out, in);
+    }
+  };
+
+
+  /*
+    Tuple size helper.
+
+    When every element has a fixed serial size, the size of the whole tuple is available
+    without an argument (and at compile time), so containers of such tuples are sized in O(1).
+  */
+  template <typename T, bool B = tuple_serial_traits<T>::serial_size_constexpr()>
+  struct tuple_size_helper;
+
+  template <typename T>
+  struct tuple_size_helper<T, false>
+  {
+    static size_t serial_size(T const & what)
+    {
+      return tuple_serial_traits<T>::serial_size(what);
+    }
+  };
+
+  template <typename T>
+  struct tuple_size_helper<T, true>
+  {
+    static constexpr size_t serial_size(T const &)
+    {
+      return serial_size();
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return tuple_serial_traits<T>::serial_size();
+    }
+  };
+
+  template <typename T>
+  struct serial_traits<T, 4>
+    : public tuple_size_helper<T>
+  {
+    static void dev_test()  { std::cout << "serial_traits(tuple)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return tuple_serial_traits<T>::serial_size_constexpr(); }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return tuple_codec_helper<T>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return tuple_codec_helper<T>::deserialize(out, in);
+    }
+
+    /*
+      Feeds bytes to the async deserializer of each element in turn.
+    */
+    class async_deserializer
+    {
+      T out;
+      typename tuple_converter<tuple_converter_type_helper, T>::type ds;
+      size_t index;
+    public:
+      async_deserializer()
+        : out(), ds(), index(0)
+      {
+      }
+
+      void reset()
+      {
+        out = T();
+        tuple_serial_traits<T>::async_reset(ds);
+        index = 0;
+      }
+
+      bool ready() const
+      {
+        return index == std::tuple_size<T>::value;
+      }
+
+      bool insert(uint8_t c)
+      {
+        return insert(&c, &c + 1).second;
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        begin = tuple_serial_traits<T>::async_insert(ds, out, index, begin, end);
+        return {begin, ready()};
+      }
+
+      /** insert(3) Add a contiguous span of bytes to the deserializer
+          @precondition ready()==false
+          @returns A std::pair<size_t, bool> .first is the number of bytes consumed. .second indicates the resulting state of ready()
+      */
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        if (!ready()) __builtin_unreachable();
+        T t = std::move(out);
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        return tuple_serial_traits<T>::async_more_min(ds, index);
+      }
+
+      size_t more_max() const
+      {
+        return tuple_serial_traits<T>::async_more_max(ds, index);
+      }
+    };
+  };
+
+
+  /*
+    Member list helpers. element<I> is the type of the I-th listed member and get<I>(obj) refers to it,
+    tuple_type is the std::tuple with the same encoding as T.
+  */
+  template <typename P>
+  struct member_pointer_helper;
+
+  template <typename C, typename M>
+  struct member_pointer_helper<M C::*>
+  {
+    using type = M;
+  };
+
+  template <typename P>
+  struct member_tuple_helper;
+
+  template <typename ... Ps>
+  struct member_tuple_helper<std::tuple<Ps...>>
+  {
+    using type = std::tuple<typename member_pointer_helper<Ps>::type...>;
+  };
+
+  template <typename T>
+  struct member_list_helper
+  {
+    using pointers = decltype(serial_members<T>::get());
+    using tuple_type = typename member_tuple_helper<pointers>::type;
+
+    static constexpr size_t size = std::tuple_size<pointers>::value;
+
+    template <size_t I>
+    using element = typename std::tuple_element<I, tuple_type>::type;
+
+    template <size_t I>
+    static element<I> const & get(T const & in)
+    {
+      constexpr auto p = std::get<I>(serial_members<T>::get());
+      return in.*p;
+    }
+
+    template <size_t I>
+    static element<I> & get(T & out)
+    {
+      constexpr auto p = std::get<I>(serial_members<T>::get());
+      return out.*p;
+    }
+  };
+
+  template <typename T, size_t I = 0, bool last = (member_list_helper<T>::size-1 == I)>
+  struct member_serial_traits;
+
+  template <typename T, size_t I>
+  struct member_serial_traits<T, I, true>
+  {
+    using E = typename member_list_helper<T>::template element<I>;
+
+    static constexpr bool serial_size_constexpr()
+    {
+      return has_noarg_serial_size<E>::value;
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return serial_traits<E>::serial_size();
+    }
+
+    static size_t serial_size(T const & in)
+    {
+      return serial_traits<E>::serial_size(member_list_helper<T>::template get<I>(in));
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return serial_traits<E>::serialize(member_list_helper<T>::template get<I>(in), out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return serial_traits<E>::deserialize(member_list_helper<T>::template get<I>(out), in);
+    }
+
+    static uint8_t const * checked_deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      return checked_deserialize_helper<E>::deserialize(member_list_helper<T>::template get<I>(out), in, end);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct member_serial_traits<T, I, false>
+  {
+    using E = typename member_list_helper<T>::template element<I>;
+
+    static constexpr bool serial_size_constexpr()
+    {
+      return has_noarg_serial_size<E>::value && member_serial_traits<T, I+1>::serial_size_constexpr();
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return serial_traits<E>::serial_size() + member_serial_traits<T, I+1>::serial_size();
+    }
+
+    static size_t serial_size(T const & in)
+    {
+      return serial_traits<E>::serial_size(member_list_helper<T>::template get<I>(in)) + member_serial_traits<T, I+1>::serial_size(in);
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<E>::serialize(member_list_helper<T>::template get<I>(in), out);
+      return member_serial_traits<T, I+1>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      in = serial_traits<E>::deserialize(member_list_helper<T>::template get<I>(out), in);
+      return member_serial_traits<T, I+1>::deserialize(out, in);
+    }
+
+    static uint8_t const * checked_deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      in = checked_deserialize_helper<E>::deserialize(member_list_helper<T>::template get<I>(out), in, end);
+      return member_serial_traits<T, I+1>::checked_deserialize(out, in, end);
+    }
+  };
+
+  /*
+    Fused codec for structs with a member list, laid out like the equivalent tuple.
+  */
+  template <typename T, size_t I = 0, bool last = (member_list_helper<T>::size-1 == I)>
+  struct fused_member_helper;
+
+  template <typename T, size_t I>
+  struct fused_member_helper<T, I, true>
+  {
+    using element_codec = fused_codec_helper<typename member_list_helper<T>::template element<I>>;
+
+    static constexpr bool value = element_codec::value;
+
+    static constexpr size_t size() { return element_codec::size(); }
+
+    static void encode(T const & in, uint8_t * p)
+    {
+      element_codec::encode(member_list_helper<T>::template get<I>(in), p);
+    }
+
+    static void decode(T & out, uint8_t const * p)
+    {
+      element_codec::decode(member_list_helper<T>::template get<I>(out), p);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct fused_member_helper<T, I, false>
+  {
+    using element_codec = fused_codec_helper<typename member_list_helper<T>::template element<I>>;
+
+    static constexpr bool value = element_codec::value && fused_member_helper<T, I+1>::value;
+
+    static constexpr size_t size() { return element_codec::size() + fused_member_helper<T, I+1>::size(); }
+
+    static void encode(T const & in, uint8_t * p)
+    {
+      element_codec::encode(member_list_helper<T>::template get<I>(in), p);
+      fused_member_helper<T, I+1>::encode(in, p + element_codec::size());
+    }
+
+    static void decode(T & out, uint8_t const * p)
+    {
+      element_codec::decode(member_list_helper<T>::template get<I>(out), p);
+      fused_member_helper<T, I+1>::decode(out, p + element_codec::size());
+    }
+  };
+
+  template <typename T>
+  struct fused_codec_helper<T, 11>
+    : public fused_member_helper<T>
+  {
+  };
+
+  template <typename T, bool B = fused_codec_helper<T>::value>
+  struct member_codec_helper;
+
+  template <typename T>
+  struct member_codec_helper<T, false>
+  {
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return member_serial_traits<T>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return member_serial_traits<T>::deserialize(out, in);
+    }
+  };
+
+  template <typename T>
+  struct member_codec_helper<T, true>
+  {
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return block_output_helper<It>::template write<fused_codec_helper<T>>(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return block_input_helper<It>::template read<fused_codec_helper<T>>(out, in);
+    }
+  };
+
+  template <typename T, bool B = member_serial_traits<T>::serial_size_constexpr()>
+  struct member_size_helper;
+
+  template <typename T>
+  struct member_size_helper<T, false>
+  {
+    static size_t serial_size(T const & what)
+    {
+      return member_serial_traits<T>::serial_size(what);
+    }
+  };
+
+  template <typename T>
+  struct member_size_helper<T, true>
+  {
+    static constexpr size_t serial_size(T const &)
+    {
+      return serial_size();
+    }
+
+    static constexpr size_t serial_size()
+    {
+      return member_serial_traits<T>::serial_size();
+    }
+  };
+
+  /*
+    Structs with a member list are encoded as the tuple of their members. Fields are read and written
+    in place through the member pointers; the async deserializer assembles the tuple and moves its
+    elements into the struct.
+  */
+  template <typename T>
+  struct serial_traits<T, 11>
+    : public member_size_helper<T>
+  {
+    using tuple_type = typename member_list_helper<T>::tuple_type;
+
+    static void dev_test()  { std::cout << "serial_traits(member list)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return member_serial_traits<T>::serial_size_constexpr(); }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return member_codec_helper<T>::serialize(in, out);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      return member_codec_helper<T>::deserialize(out, in);
+    }
+
+    class async_deserializer
+    {
+      typename serial_traits<tuple_type>::async_deserializer ds;
+
+      template <size_t I>
+      static void assign(T & out, tuple_type & t, std::true_type)
+      {
+        member_list_helper<T>::template get<I>(out) = std::move(std::get<I>(t));
+      }
+
+      template <size_t I>
+      static void assign(T & out, tuple_type & t, std::false_type)
+      {
+        member_list_helper<T>::template get<I>(out) = std::move(std::get<I>(t));
+        assign<I+1>(out, t, std::integral_constant<bool, I+2 == member_list_helper<T>::size>());
+      }
+    public:
+      void reset()
+      {
+        ds.reset();
+      }
+
+      bool ready() const
+      {
+        return ds.ready();
+      }
+
+      bool insert(uint8_t c)
+      {
+        return ds.insert(c);
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        return ds.insert(begin, end);
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        return ds.insert(data, n);
+      }
+
+      T get()
+      {
+        tuple_type t = ds.get();
+        T out{};
+        assign<0>(out, t, std::integral_constant<bool, 1 == member_list_helper<T>::size>());
+        return out;
+      }
+
+      size_t more_min() const
+      {
+        return ds.more_min();
+      }
+
+      size_t more_max() const
+      {
+        return ds.more_max();
+      }
+    };
+  };
+
+
+#if __cplusplus >= 201703L
+  template <template <typename> typename Templ, typename ... Ts>
+  class tuple_converter< Templ,  std::variant<Ts...> >
+  {
+  public:
+    using type = typename std::variant<typename Templ<Ts>::type...>;
+  };
+
+  /*
+    std::optional is encoded as a one byte tag (0 for empty, 1 when a value follows) and then the value.
+  */
+  template <typename T>
+  struct serial_traits<T, 9>
+  {
+    using value_type = typename T::value_type;
+
+    static void dev_test()  { std::cout << "serial_traits(optional)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(T const & in)
+    {
+      return in ? 1 + serial_traits<value_type>::serial_size(*in) : 1;
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      out = serial_traits<uint8_t>::serialize(in ? 1 : 0, out);
+      if (in) out = serial_traits<value_type>::serialize(*in, out);
+      return out;
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      uint8_t tag;
+      in = serial_traits<uint8_t>::deserialize(tag, in);
+      if (tag == 0)
+        {
+          out.reset();
+          return in;
+        }
+      out.emplace();
+      return serial_traits<value_type>::deserialize(*out, in);
+    }
+
+    class async_deserializer
+    {
+      T out;
+      typename serial_traits<value_type>::async_deserializer td;
+      int stage;
+    public:
+      async_deserializer()
+        : stage(0)
+      {
+      }
+
+      void reset()
+      {
+        out.reset();
+        td.reset();
+        stage = 0;
+      }
+
+      bool ready() const
+      {
+        return stage == 2;
+      }
+
+      bool insert(uint8_t c)
+      {
+        return insert(&c, &c + 1).second;
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (begin == end) return {begin, false};
+        if (stage == 0)
+          {
+            uint8_t tag = *begin;
+            ++begin;
+            stage = tag == 0 ? 2 : 1;
+            if (stage == 2 || begin == end) return {begin, ready()};
+          }
+        auto r = td.insert(begin, end);
+        if (r.second)
+          {
+            out.emplace(td.get());
+            stage = 2;
+          }
+        return {r.first, ready()};
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        if (!ready()) __builtin_unreachable();
+        T t = std::move(out);
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        if (stage == 0) return 1;
+        return stage == 1 ? td.more_min() : 0;
+      }
+
+      size_t more_max() const
+      {
+        if (stage == 0) return saturating_add(1, td.more_max());
+        return stage == 1 ? td.more_max() : 0;
+      }
+    };
+  };
+
+  template <typename T, size_t I = 0, bool last = (std::variant_size<T>::value-1 == I)>
+  struct variant_serial_traits
+  {
+    using alternative = typename std::variant_alternative<I, T>::type;
+
+    template <typename It>
+    static auto deserialize(T & out, size_t index, It in) -> It
+    {
+      if (index != I) return variant_serial_traits<T, I+1>::deserialize(out, index, in);
+      return serial_traits<alternative>::deserialize(out.template emplace<I>(), in);
+    }
+
+    template <typename D>
+    static void async_start(D & ds, size_t index)
+    {
+      if (index != I) return variant_serial_traits<T, I+1>::async_start(ds, index);
+      ds.template emplace<I>();
+    }
+
+    template <typename D, typename It>
+    static auto async_insert(D & ds, T & out, size_t index, It begin, It end) -> std::pair<It, bool>
+    {
+      if (index != I) return variant_serial_traits<T, I+1>::async_insert(ds, out, index, begin, end);
+      auto r = std::get<I>(ds).insert(begin, end);
+      if (r.second) out.template emplace<I>(std::get<I>(ds).get());
+      return r;
+    }
+  };
+
+  template <typename T, size_t I>
+  struct variant_serial_traits<T, I, true>
+  {
+    using alternative = typename std::variant_alternative<I, T>::type;
+
+    template <typename It>
+    static auto deserialize(T & out, size_t index, It in) -> It
+    {
+      if (index != I) throw deserialize_error("variant index out of range");
+      return serial_traits<alternative>::deserialize(out.template emplace<I>(), in);
+    }
+
+    template <typename D>
+    static void async_start(D & ds, size_t index)
+    {
+      if (index != I) throw deserialize_error("variant index out of range");
+      ds.template emplace<I>();
+    }
+
+    template <typename D, typename It>
+    static auto async_insert(D & ds, T & out, size_t, It begin, It end) -> std::pair<It, bool>
+    {
+      auto r = std::get<I>(ds).insert(begin, end);
+      if (r.second) out.template emplace<I>(std::get<I>(ds).get());
+      return r;
+    }
+  };
+
+  /*
+    std::variant is encoded as the uintany index of the active alternative and then its value.
+    Serializing a valueless variant throws std::bad_variant_access.
+  */
+  template <typename T>
+  struct serial_traits<T, 10>
+  {
+    static void dev_test()  { std::cout << "serial_traits(variant)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(T const & in)
+    {
+      return std::visit([&](auto const & v) -> size_t
+        {
+          return serial_traits<uintany>::encoded_size(in.index()) + serial_traits<typename std::decay<decltype(v)>::type>::serial_size(v);
+        }, in);
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return std::visit([&](auto const & v) -> It
+        {
+          It o = serial_traits<uintany>::serialize(in.index(), out);
+          return serial_traits<typename std::decay<decltype(v)>::type>::serialize(v, o);
+        }, in);
+    }
+
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      size_t index;
+      in = serial_traits<uintany>::deserialize(index, in);
+      return variant_serial_traits<T>::deserialize(out, index, in);
+    }
+
+    class async_deserializer
+    {
+      T out;
+      typename serial_traits<uintany>::async_deserializer szd;
+      typename tuple_converter<tuple_converter_type_helper, T>::type ds;
+      size_t index;
+      int stage;
+    public:
+      async_deserializer()
+        : index(0), stage(0)
+      {
+      }
+
+      void reset()
+      {
+        szd.reset();
+        index = 0;
+        stage = 0;
+      }
+
+      bool ready() const
+      {
+        return stage == 2;
+      }
+
+      bool insert(uint8_t c)
+      {
+        return insert(&c, &c + 1).second;
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        if (stage == 0)
+          {
+            auto r = szd.insert(begin, end);
+            begin = r.first;
+            if (!r.second) return {begin, false};
+            index = szd.get();
+            variant_serial_traits<T>::async_start(ds, index);
+            stage = 1;
+            if (begin == end) return {begin, false};
+          }
+        auto r = variant_serial_traits<T>::async_insert(ds, out, index, begin, end);
+        if (r.second) stage = 2;
+        return r;
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        if (!ready()) __builtin_unreachable();
+        T t = std::move(out);
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        if (stage == 0) return szd.more_min();
+        if (stage == 2) return 0;
+        return std::visit([](auto const & d) { return d.more_min(); }, ds);
+      }
+
+      size_t more_max() const
+      {
+        if (stage == 0) return SIZE_MAX;
+        if (stage == 2) return 0;
+        return std::visit([](auto const & d) { return d.more_max(); }, ds);
+      }
+    };
+  };
+#endif
+
+  template <typename T>
+  struct serial_traits<T const, 0>
+    : public serial_traits<T>
+  {
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      return serial_traits<T>::serialize(in, std::move(out));
+    }
+  };
+
+
+  template <typename T, typename It>
+  struct serial_helper
+  {
+    static auto serialize(T const & in, It out) -> It
+    {
+      return serial_traits<T>::serialize(in, out);
+    }
+    static auto deserialize(T  & out, It in) -> It
+    {
+      return serial_traits<T>::deserialize(out, in);
+    }
+  };
+  
+
+  template <typename I>
+  struct serial_traits< big_endian<I>, 0 >
+  {
+    template <typename It>
+    static auto serialize(I const & num, It out) -> It
+    {
+      I copy = num;
+      
+      for (size_t i = 0; i < sizeof(I); i++)
+      {
+        *out = 0xFF & (copy >> ((sizeof(I) - i - 1)*8));
+        ++out;
+      }
+      return out;
+    }
+    
+    template <typename It>
+    static auto deserialize(I & out, It in) -> It
+    {
+      I fout = 0;
+      for (size_t i = 0; i < sizeof(I); i++)
+      {
+        fout <<= 8;
+        fout |= static_cast<uint8_t>(*in);
+        ++in;
+      }
+      
+      return in;
+    }
+    
+    static constexpr size_t serial_size(I const &)
+    {
+      return sizeof(I);
+    }
+    
+    static constexpr size_t serial_size()
+    {
+      return sizeof(I);
+    }
+  };
+
+
+  /*
+    Zero-copy views.
+
+    Views serialize exactly like the owning container they stand in for (a uintany count followed by the
+    elements), so they can read data written from a std::string or std::vector and vice versa.
+    Deserializing into a view requires contiguous input; the view then points directly into the input
+    buffer instead of copying, so the buffer must outlive the view.
+  */
+
+  /*
+    Read-only view of a serialized run of integral values. Elements are decoded from the underlying bytes on access.
+  */
+  template <typename T>
+  class array_view
+  {
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value, "array_view requires an integral element type");
+
+    uint8_t const * m_data;
+    size_t m_size;
+  public:
+    class const_iterator
+    {
+      uint8_t const * p;
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = T;
+
+      explicit const_iterator(uint8_t const * p_)
+        : p(p_)
+      {
+      }
+
+      T operator*() const
+      {
+        return load_le<T>(p);
+      }
+
+      const_iterator & operator++()
+      {
+        p += sizeof(T);
+        return *this;
+      }
+
+      const_iterator operator++(int)
+      {
+        const_iterator t = *this;
+        p += sizeof(T);
+        return t;
+      }
+
+      bool operator==(const_iterator const & other) const { return p == other.p; }
+      bool operator!=(const_iterator const & other) const { return p != other.p; }
+    };
+
+    array_view()
+      : m_data(nullptr), m_size(0)
+    {
+    }
+
+    array_view(uint8_t const * data, size_t size)
+      : m_data(data), m_size(size)
+    {
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /*
+      Returns the encoded elements, sizeof(T)*size() bytes in little endian order.
+    */
+    uint8_t const * data() const { return m_data; }
+
+    T operator[](size_t i) const
+    {
+      return load_le<T>(m_data + i*sizeof(T));
+    }
+
+    const_iterator begin() const { return const_iterator(m_data); }
+    const_iterator end() const { return const_iterator(m_data + m_size*sizeof(T)); }
+
+    std::vector<T> to_vector() const
+    {
+      std::vector<T> out(m_size);
+      if (m_size != 0) bulk_element_helper<std::vector<T>>::decode(m_data, m_size, out.data());
+      return out;
+    }
+  };
+
+  /*
+    Shared implementation for views of contiguous single byte elements.
+  */
+  template <typename V, typename C>
+  struct byte_view_serial_traits
+  {
+    static_assert(sizeof(C) == 1, "byte views require a single byte element type");
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(V const & in)
+    {
+      return serial_traits<uintany>::encoded_size(in.size()) + in.size();
+    }
+
+    template <typename It>
+    static auto serialize(V const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+      return object_output_helper<It>::write(reinterpret_cast<uint8_t const *>(in.data()), in.size(), out);
+    }
+
+    template <typename It>
+    static auto deserialize(V & out, It in) -> It
+    {
+      static_assert(contiguous_input_helper<It>::value, "views can only be deserialized from contiguous input");
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      if (count == 0)
+        {
+          out = V();
+          return in;
+        }
+      uint8_t const * p = contiguous_input_helper<It>::acquire(in, count);
+      out = V(reinterpret_cast<C const *>(p), count);
+      return in;
+    }
+
+    static uint8_t const * deserialize(V & out, uint8_t const * in, uint8_t const * end)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      check_remaining(in, end, count);
+      out = V(reinterpret_cast<C const *>(in), count);
+      return in + count;
+    }
+  };
+
+#if __cplusplus >= 201703L
+  template <typename C, typename Tr>
+  struct serial_traits<std::basic_string_view<C, Tr>, 0>
+    : public byte_view_serial_traits<std::basic_string_view<C, Tr>, C>
+  {
+    static void dev_test()  { std::cout << "serial_traits(string_view)" << std::endl; }
+  };
+#endif
+
+#ifdef __cpp_lib_span
+  template <>
+  struct serial_traits<std::span<uint8_t const>, 0>
+    : public byte_view_serial_traits<std::span<uint8_t const>, uint8_t>
+  {
+    static void dev_test()  { std::cout << "serial_traits(span)" << std::endl; }
+  };
+#endif
+
+  template <typename T>
+  struct serial_traits<array_view<T>, 0>
+  {
+    static void dev_test()  { std::cout << "serial_traits(array_view)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    static size_t serial_size(array_view<T> const & in)
+    {
+      return serial_traits<uintany>::encoded_size(in.size()) + in.size()*sizeof(T);
+    }
+
+    template <typename It>
+    static auto serialize(array_view<T> const & in, It out) -> It
+    {
+      out = serial_traits<uintany>::serialize(in.size(), out);
+      return object_output_helper<It>::write(in.data(), in.size()*sizeof(T), out);
+    }
+
+    template <typename It>
+    static auto deserialize(array_view<T> & out, It in) -> It
+    {
+      static_assert(contiguous_input_helper<It>::value, "views can only be deserialized from contiguous input");
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      if (count == 0)
+        {
+          out = array_view<T>();
+          return in;
+        }
+      out = array_view<T>(contiguous_input_helper<It>::acquire(in, count*sizeof(T)), count);
+      return in;
+    }
+
+    static uint8_t const * deserialize(array_view<T> & out, uint8_t const * in, uint8_t const * end)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      if (count > size_t(end - in)/sizeof(T)) throw deserialize_error("unexpected end of input");
+      out = array_view<T>(in, count);
+      return in + count*sizeof(T);
+    }
+  };
+
+  /*
+    Skip helpers.
+
+    skip(in) returns a pointer past the value encoded at in. Fixed size values are stepped over without
+    being read, and containers only walk elements whose size varies. Types with no better option
+    (user defined traits) are deserialized into a temporary.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case(), bool F = has_noarg_serial_size<T>::value>
+  struct serial_skip_helper;
+
+  template <typename T, bool F = has_noarg_serial_size<T>::value>
+  struct serial_skip_n_helper;
+
+  template <typename T>
+  struct serial_skip_n_helper<T, true>
+  {
+    static uint8_t const * skip_n(uint8_t const * in, size_t count)
+    {
+      return in + count*serial_traits<T>::serial_size();
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_n_helper<T, false>
+  {
+    static uint8_t const * skip_n(uint8_t const * in, size_t count)
+    {
+      for (size_t i = 0; i < count; i++)
+        {
+          in = serial_skip_helper<T>::skip(in);
+        }
+      return in;
+    }
+  };
+
+  template <typename T, int C>
+  struct serial_skip_helper<T, C, true>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      return in + serial_traits<T>::serial_size();
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 0, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      T t;
+      return serial_traits<T>::deserialize(t, in);
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T const, 0, false>
+    : public serial_skip_helper<T>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 7, false>
+    : public serial_skip_helper<typename std::remove_reference<T>::type>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 3, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return serial_skip_n_helper<typename T::value_type>::skip_n(in, count);
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 8, false>
+    : public serial_skip_helper<T, 3, false>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 5, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return serial_skip_n_helper<std::pair<typename T::key_type, typename T::mapped_type>>::skip_n(in, count);
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 12, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in);
+      return in + packed_bit_bytes(count);
+    }
+  };
+
+  template <typename T, size_t I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
+  struct tuple_skip_helper;
+
+  template <typename T, size_t I>
+  struct tuple_skip_helper<T, I, true>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      return serial_skip_helper<typename std::tuple_element<I, T>::type>::skip(in);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct tuple_skip_helper<T, I, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      in = serial_skip_helper<typename std::tuple_element<I, T>::type>::skip(in);
+      return tuple_skip_helper<T, I+1>::skip(in);
+    }
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 4, false>
+    : public tuple_skip_helper<T>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 11, false>
+    : public serial_skip_helper<typename member_list_helper<T>::tuple_type>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 9, false>
+    : public serial_skip_helper<T, 0, false>
+  {
+  };
+
+  template <typename T>
+  struct serial_skip_helper<T, 10, false>
+    : public serial_skip_helper<T, 0, false>
+  {
+  };
+
+  /*
+    Indexed containers.
+
+    indexed<C, N> is a vector-like, set-like or map-like container that is serialized together with a
+    sparse offset index, so that element i can be found without decoding the elements before it. The
+    encoding is
+
+      uintany  count*2 + 1
+      uintany  N
+      uintany  the size in bytes of the elements
+               the elements, as serial_traits<C> writes them
+      uintany  for k = 1 ... (count - 1)/N, the offset of element k*N minus that of element (k - 1)*N
+
+    Containers of at most N elements, for which the index would be empty, are written as count*2 and
+    the elements. The index costs about one byte per N elements.
+  */
+  template <typename C, size_t N = 4096>
+  class indexed
+    : public C
+  {
+    static_assert(N != 0, "indexed requires a non zero index interval");
+  public:
+    using C::C;
+
+    indexed() = default;
+
+    indexed(C const & c)
+      : C(c)
+    {
+    }
+
+    indexed(C && c)
+      : C(std::move(c))
+    {
+    }
+  };
+
+  /*
+    The framing of an indexed<C, N> encoding. every and size are 0 when there is no index.
+  */
+  struct indexed_header
+  {
+    size_t count;
+    size_t every;
+    size_t size;
+
+    /*
+      The number of entries in the index, counting the implicit first one.
+    */
+    size_t groups() const
+    {
+      return every == 0 ? 0 : count/every + (count%every != 0);
+    }
+
+    /*
+      Reads the header at in and returns a pointer to the first element.
+    */
+    uint8_t const * read(uint8_t const * in)
+    {
+      size_t h;
+      in = serial_traits<uintany>::deserialize(h, in);
+      count = h >> 1;
+      every = 0;
+      size = 0;
+      if (h & 1)
+        {
+          in = serial_traits<uintany>::deserialize(every, in);
+          in = serial_traits<uintany>::deserialize(size, in);
+        }
+      return in;
+    }
+
+    uint8_t const * read(uint8_t const * in, uint8_t const * end)
+    {
+      size_t h;
+      in = serial_traits<uintany>::deserialize(h, in, end);
+      count = h >> 1;
+      every = 0;
+      size = 0;
+      if (h & 1)
+        {
+          in = serial_traits<uintany>::deserialize(every, in, end);
+          in = serial_traits<uintany>::deserialize(size, in, end);
+          if (every == 0) throw deserialize_error("invalid container index");
+          check_remaining(in, end, size);
+        }
+      return in;
+    }
+  };
+
+  /*
+    The type elements of C are decoded as.
+  */
+  template <typename C, int B = serial_traits_base_cases<C>::base_case()>
+  struct indexed_element_helper
+  {
+    using type = typename C::value_type;
+  };
+
+  template <typename C>
+  struct indexed_element_helper<C, 5>
+  {
+    using type = std::pair<typename C::key_type, typename C::mapped_type>;
+  };
+
+  template <typename C, size_t N>
+  struct serial_traits<indexed<C, N>, 0>
+  {
+    using T = indexed<C, N>;
+    using E = typename indexed_element_helper<C>::type;
+
+    static void dev_test()  { std::cout << "serial_traits(indexed)" << std::endl; }
+
+    static constexpr bool serial_size_constexpr() { return false; }
+
+    /*
+      The offsets of elements 0, N, 2N ... counted from the first element, then the size of all the elements.
+    */
+    static std::vector<size_t> offsets(T const & what)
+    {
+      std::vector<size_t> r;
+      r.reserve(what.size()/N + 2);
+      size_t pos = 0;
+      size_t i = 0;
+      for (auto const & x : what)
+        {
+          if (i++ % N == 0) r.push_back(pos);
+          pos += serial_traits<typename C::value_type>::serial_size(x);
+        }
+      r.push_back(pos);
+      return r;
+    }
+
+    static size_t serial_size(T const & what)
+    {
+      if (what.size() <= N)
+        {
+          return serial_traits<C>::serial_size(what) - serial_traits<uintany>::encoded_size(what.size()) + serial_traits<uintany>::encoded_size(what.size()*2);
+        }
+      std::vector<size_t> r = offsets(what);
+      size_t sz = serial_traits<uintany>::encoded_size(what.size()*2 + 1) + serial_traits<uintany>::encoded_size(N);
+      sz += serial_traits<uintany>::encoded_size(r.back()) + r.back();
+      for (size_t k = 1; k + 1 < r.size(); k++)
+        {
+          sz += serial_traits<uintany>::encoded_size(r[k] - r[k - 1]);
+        }
+      return sz;
+    }
+
+    template <typename It>
+    static auto serialize(T const & in, It out) -> It
+    {
+      std::vector<size_t> r;
+      if (in.size() <= N)
+        {
+          out = serial_traits<uintany>::serialize(in.size()*2, out);
+        }
+      else
+        {
+          r = offsets(in);
+          out = serial_traits<uintany>::serialize(in.size()*2 + 1, out);
+          out = serial_traits<uintany>::serialize(N, out);
+          out = serial_traits<uintany>::serialize(r.back(), out);
+        }
+      for (auto const & x : in)
+        {
+          out = serial_traits<typename C::value_type>::serialize(x, out);
+        }
+      for (size_t k = 1; k + 1 < r.size(); k++)
+        {
+          out = serial_traits<uintany>::serialize(r[k] - r[k - 1], out);
+        }
+      return out;
+    }
+
+    /*
+      Replaces the contents of out.
+    */
+    template <typename It>
+    static auto deserialize(T & out, It in) -> It
+    {
+      indexed_header h;
+      size_t v;
+      in = serial_traits<uintany>::deserialize(v, in);
+      h.count = v >> 1;
+      h.every = 0;
+      if (v & 1)
+        {
+          in = serial_traits<uintany>::deserialize(h.every, in);
+          in = serial_traits<uintany>::deserialize(v, in);
+        }
+      out.clear();
+      reserve_helper<C>::reserve(out, h.count);
+      for (size_t i = 0; i < h.count; i++)
+        {
+          E e = make_element<E>(out);
+          in = serial_traits<E>::deserialize(e, in);
+          out.insert(out.end(), std::move(e));
+        }
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          in = serial_traits<uintany>::deserialize(v, in);
+        }
+      return in;
+    }
+
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      indexed_header h;
+      in = h.read(in, end);
+      uint8_t const * last = h.every == 0 ? end : in + h.size;
+      // Every element takes at least one byte.
+      if (h.count > size_t(last - in)) throw deserialize_error("container count exceeds input");
+      out.clear();
+      reserve_helper<C>::reserve(out, h.count);
+      for (size_t i = 0; i < h.count; i++)
+        {
+          E e = make_element<E>(out);
+          in = checked_deserialize_helper<E>::deserialize(e, in, last);
+          out.insert(out.end(), std::move(e));
+        }
+      if (h.every != 0 && in != last) throw deserialize_error("container size does not match input");
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          size_t d;
+          in = serial_traits<uintany>::deserialize(d, in, end);
+        }
+      return in;
+    }
+
+    class async_deserializer
+    {
+      static constexpr size_t reserve_limit = 65536;
+
+      T out;
+      typename serial_traits<uintany>::async_deserializer ds;
+      typename serial_traits<E>::async_deserializer es;
+      indexed_header h;
+      size_t i;
+      int stage;
+
+      // Steps past stages with nothing left to read.
+      void settle()
+      {
+        if (stage == 3 && i == h.count)
+          {
+            stage = 4;
+            i = 1;
+          }
+        if (stage == 4 && i >= h.groups()) stage = 5;
+      }
+
+    public:
+      async_deserializer()
+      {
+        reset();
+      }
+
+      void reset()
+      {
+        out = T();
+        ds.reset();
+        es.reset();
+        h = indexed_header{0, 0, 0};
+        i = 0;
+        stage = 0;
+      }
+
+      bool ready() const
+      {
+        return stage == 5;
+      }
+
+      bool insert(uint8_t c)
+      {
+        return insert(&c, &c + 1).second;
+      }
+
+      template <typename It>
+      auto insert(It begin, It end) -> std::pair<It, bool>
+      {
+        if (ready()) __builtin_unreachable();
+        while (begin != end && !ready())
+          {
+            if (stage == 3)
+              {
+                auto r = es.insert(begin, end);
+                begin = r.first;
+                if (!r.second) break;
+                out.insert(out.end(), es.get());
+                i++;
+                settle();
+                continue;
+              }
+            auto r = ds.insert(begin, end);
+            begin = r.first;
+            if (!r.second) break;
+            size_t v = ds.get();
+            if (stage == 0)
+              {
+                h.count = v >> 1;
+                reserve_helper<C>::reserve(out, h.count < reserve_limit ? h.count : reserve_limit);
+                stage = v & 1 ? 1 : 3;
+              }
+            else if (stage == 1)
+              {
+                h.every = v;
+                stage = 2;
+              }
+            else if (stage == 2)
+              {
+                h.size = v;
+                stage = 3;
+              }
+            else
+              {
+                i++;
+              }
+            settle();
+          }
+        return {begin, ready()};
+      }
+
+      auto insert(uint8_t const * data, size_t n) -> std::pair<size_t, bool>
+      {
+        auto r = insert(data, data + n);
+        return {size_t(r.first - data), r.second};
+      }
+
+      T get()
+      {
+        if (!ready()) __builtin_unreachable();
+        T t = std::move(out);
+        reset();
+        return t;
+      }
+
+      size_t more_min() const
+      {
+        if (ready()) return 0;
+        if (stage == 3) return es.more_min();
+        if (stage == 4) return saturating_add(ds.more_min(), h.groups() - i - 1);
+        return ds.more_min();
+      }
+
+      size_t more_max() const
+      {
+        if (ready()) return 0;
+        if (stage == 4) return saturating_add(ds.more_max(), saturating_mul(h.groups() - i - 1, serial_traits<uintany>::encoded_size(UINTMAX_MAX)));
+        return SIZE_MAX;
+      }
+    };
+  };
+
+  template <typename C, size_t N>
+  struct serial_skip_helper<indexed<C, N>, 0, false>
+  {
+    static uint8_t const * skip(uint8_t const * in)
+    {
+      indexed_header h;
+      in = h.read(in);
+      if (h.every == 0) return serial_skip_n_helper<typename indexed_element_helper<C>::type>::skip_n(in, h.count);
+      in += h.size;
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          size_t d;
+          in = serial_traits<uintany>::deserialize(d, in);
+        }
+      return in;
+    }
+  };
+
+  /*
+    Element index over a serialized container body.
+
+    scan(in) reads the uintany element count at in and locates the elements. When E has a fixed
+    serial size the elements are found by stride and nothing else is read; otherwise the elements
+    are skipped over once and their offsets recorded. scan(in, end) does the same for untrusted input:
+    the count is checked against the bytes in [in, end) before anything is reserved, and each element
+    is decoded with the checked decoders, so elements can later be read without bounds checks.
+  */
+  template <typename E, bool F = has_noarg_serial_size<E>::value>
+  class serialized_index;
+
+  template <typename E>
+  class serialized_index<E, true>
+  {
+    uint8_t const * m_first;
+    size_t m_size;
+  public:
+    serialized_index()
+      : m_first(nullptr), m_size(0)
+    {
+    }
+
+    uint8_t const * scan(uint8_t const * in)
+    {
+      m_first = serial_traits<uintany>::deserialize(m_size, in);
+      return end();
+    }
+
+    uint8_t const * scan(uint8_t const * in, uint8_t const * end)
+    {
+      m_first = serial_traits<uintany>::deserialize(m_size, in, end);
+      check_count(m_first, end, m_size, stride());
+      return this->end();
+    }
+
+    size_t size() const { return m_size; }
+
+    static constexpr size_t stride() { return serial_traits<E>::serial_size(); }
+
+    uint8_t const * element(size_t i) const { return m_first + i*stride(); }
+
+    uint8_t const * end() const { return element(m_size); }
+  };
+
+  template <typename E>
+  class serialized_index<E, false>
+  {
+    uint8_t const * m_first;
+    std::vector<size_t> m_offsets;
+  public:
+    serialized_index()
+      : m_first(nullptr), m_offsets(1, 0)
+    {
+    }
+
+    uint8_t const * scan(uint8_t const * in)
+    {
+      size_t count;
+      m_first = serial_traits<uintany>::deserialize(count, in);
+      m_offsets.clear();
+      m_offsets.reserve(count + 1);
+      uint8_t const * p = m_first;
+      m_offsets.push_back(0);
+      for (size_t i = 0; i < count; i++)
+        {
+          p = serial_skip_helper<E>::skip(p);
+          m_offsets.push_back(size_t(p - m_first));
+        }
+      return p;
+    }
+
+    uint8_t const * scan(uint8_t const * in, uint8_t const * end)
+    {
+      size_t count;
+      m_first = serial_traits<uintany>::deserialize(count, in, end);
+      // Every element takes at least one byte.
+      if (count > size_t(end - m_first)) throw deserialize_error("container count exceeds input");
+      m_offsets.clear();
+      m_offsets.reserve(count + 1);
+      uint8_t const * p = m_first;
+      m_offsets.push_back(0);
+      for (size_t i = 0; i < count; i++)
+        {
+          E e;
+          p = checked_deserialize_helper<E>::deserialize(e, p, end);
+          m_offsets.push_back(size_t(p - m_first));
+        }
+      return p;
+    }
+
+    size_t size() const { return m_offsets.size() - 1; }
+
+    uint8_t const * element(size_t i) const { return m_first + m_offsets[i]; }
+
+    uint8_t const * end() const { return element(size()); }
+  };
+
+  /*
+    Element index over an indexed<C, N> encoding. scan(in) reads the header and the offset index, and
+    element(i) starts from the nearest indexed element and skips fewer than N elements. Encodings
+    without an index are scanned like serialized_index does. scan(in, end) also decodes every element
+    with the checked decoders and throws unless each group ends where the next indexed offset says.
+  */
+  template <typename E>
+  class indexed_serialized_index
+  {
+    uint8_t const * m_first;
+    size_t m_size;
+    size_t m_every;
+    std::vector<size_t> m_offsets;
+  public:
+    indexed_serialized_index()
+      : m_first(nullptr), m_size(0), m_every(1), m_offsets(1, 0)
+    {
+    }
+
+    uint8_t const * scan(uint8_t const * in)
+    {
+      indexed_header h;
+      m_first = h.read(in);
+      m_size = h.count;
+      m_offsets.clear();
+      m_offsets.push_back(0);
+      uint8_t const * p = m_first;
+      if (h.every == 0)
+        {
+          m_every = 1;
+          m_offsets.reserve(m_size + 1);
+          for (size_t i = 0; i < m_size; i++)
+            {
+              p = serial_skip_helper<E>::skip(p);
+              m_offsets.push_back(size_t(p - m_first));
+            }
+          return p;
+        }
+      m_every = h.every;
+      m_offsets.reserve(h.groups() + 1);
+      p += h.size;
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          size_t d;
+          p = serial_traits<uintany>::deserialize(d, p);
+          m_offsets.push_back(m_offsets.back() + d);
+        }
+      m_offsets.push_back(h.size);
+      return p;
+    }
+
+    uint8_t const * scan(uint8_t const * in, uint8_t const * end)
+    {
+      indexed_header h;
+      m_first = h.read(in, end);
+      m_size = h.count;
+      uint8_t const * last = h.every == 0 ? end : m_first + h.size;
+      // Every element takes at least one byte.
+      if (m_size > size_t(last - m_first)) throw deserialize_error("container count exceeds input");
+      m_offsets.clear();
+      m_offsets.push_back(0);
+      uint8_t const * p = m_first;
+      if (h.every == 0)
+        {
+          m_every = 1;
+          m_offsets.reserve(m_size + 1);
+          for (size_t i = 0; i < m_size; i++)
+            {
+              E e;
+              p = checked_deserialize_helper<E>::deserialize(e, p, end);
+              m_offsets.push_back(size_t(p - m_first));
+            }
+          return p;
+        }
+      m_every = h.every;
+      m_offsets.reserve(h.groups() + 1);
+      p = last;
+      for (size_t k = 1; k < h.groups(); k++)
+        {
+          size_t d;
+          p = serial_traits<uintany>::deserialize(d, p, end);
+          if (d > h.size - m_offsets.back()) throw deserialize_error("invalid container index");
+          m_offsets.push_back(m_offsets.back() + d);
+        }
+      m_offsets.push_back(h.size);
+      uint8_t const * q = m_first;
+      for (size_t i = 0; i < m_size; i++)
+        {
+          E e;
+          q = checked_deserialize_helper<E>::deserialize(e, q, last);
+          if ((i + 1)%m_every == 0 || i + 1 == m_size)
+            {
+              if (q != m_first + m_offsets[i/m_every + 1]) throw deserialize_error("container size does not match input");
+            }
+        }
+      return p;
+    }
+
+    size_t size() const { return m_size; }
+
+    uint8_t const * element(size_t i) const
+    {
+      if (i == m_size) return end();
+      return serial_skip_n_helper<E>::skip_n(m_first + m_offsets[i/m_every], i%m_every);
+    }
+
+    uint8_t const * end() const { return m_first + m_offsets.back(); }
+  };
+
+  /*
+    The element index a serialized view of T uses.
+  */
+  template <typename T, typename E>
+  struct serialized_index_helper
+  {
+    using type = serialized_index<E>;
+  };
+
+  template <typename C, size_t N, typename E>
+  struct serialized_index_helper<indexed<C, N>, E>
+  {
+    using type = indexed_serialized_index<E>;
+  };
+
+  /*
+    Iterator over a serialized view. Dereferencing decodes the element at the current index.
+  */
+  template <typename V>
+  class serialized_view_iterator
+  {
+    V const * v;
+    size_t i;
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = typename V::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    serialized_view_iterator(V const * v_, size_t i_)
+      : v(v_), i(i_)
+    {
+    }
+
+    value_type operator*() const { return v->get(i); }
+
+    serialized_view_iterator & operator++()
+    {
+      i++;
+      return *this;
+    }
+
+    serialized_view_iterator operator++(int)
+    {
+      serialized_view_iterator t = *this;
+      i++;
+      return t;
+    }
+
+    size_t index() const { return i; }
+
+    bool operator==(serialized_view_iterator const & other) const { return i == other.i; }
+    bool operator!=(serialized_view_iterator const & other) const { return i != other.i; }
+  };
+
+  /*
+    Read-only view of a serialized vector-like container (as written by serial_traits<T, 3>, or with
+    an offset index when T is an indexed<C, N>).
+    Only the framing is read on construction; elements are decoded on access.
+    The view does not copy the input, so the buffer must outlive it.
+  */
+  template <typename T>
+  class serialized_vector_view
+  {
+  public:
+    using value_type = typename T::value_type;
+    using const_iterator = serialized_view_iterator<serialized_vector_view>;
+  private:
+    typename serialized_index_helper<T, value_type>::type m_index;
+    uint8_t const * m_end;
+  public:
+    serialized_vector_view()
+      : m_end(nullptr)
+    {
+    }
+
+    explicit serialized_vector_view(uint8_t const * in)
+    {
+      m_end = m_index.scan(in);
+    }
+
+    /*
+      Views the container serialized at the start of [begin, end), checking it against end with the
+      checked decoders. Throws deserialize_error if the input is truncated or malformed.
+    */
+    serialized_vector_view(uint8_t const * begin, uint8_t const * end)
+    {
+      m_end = m_index.scan(begin, end);
+    }
+
+    size_t size() const { return m_index.size(); }
+    bool empty() const { return size() == 0; }
+
+    /*
+      Returns a pointer past the last byte of the serialized container.
+    */
+    uint8_t const * data_end() const { return m_end; }
+
+    value_type get(size_t i) const
+    {
+      value_type t;
+      serial_traits<value_type>::deserialize(t, m_index.element(i));
+      return t;
+    }
+
+    value_type operator[](size_t i) const { return get(i); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+  };
+
+  /*
+    Binary search over the keys of a sorted serialized view. Returns the index of the first key
+    that is not less than (lower bound) or is greater than (upper bound) k.
+  */
+  template <typename Compare, typename V, typename K>
+  size_t serialized_lower_bound(V const & v, K const & k)
+  {
+    Compare comp;
+    size_t lo = 0;
+    size_t hi = v.size();
+    while (lo < hi)
+      {
+        size_t mid = lo + (hi - lo)/2;
+        if (comp(v.key(mid), k)) lo = mid + 1;
+        else hi = mid;
+      }
+    return lo;
+  }
+
+  template <typename Compare, typename V, typename K>
+  size_t serialized_upper_bound(V const & v, K const & k)
+  {
+    Compare comp;
+    size_t lo = 0;
+    size_t hi = v.size();
+    while (lo < hi)
+      {
+        size_t mid = lo + (hi - lo)/2;
+        if (!comp(k, v.key(mid))) lo = mid + 1;
+        else hi = mid;
+      }
+    return lo;
+  }
+
+  /*
+    Read-only view of a serialized map-like container (as written by serial_traits<T, 5>, or with an
+    offset index when T is an indexed<C, N>).
+    Keys and values are decoded separately, so find() only decodes keys.
+  */
+  template <typename T>
+  class serialized_map_view
+  {
+  public:
+    using key_type = typename T::key_type;
+    using mapped_type = typename T::mapped_type;
+    using value_type = std::pair<key_type, mapped_type>;
+    using const_iterator = serialized_view_iterator<serialized_map_view>;
+  private:
+    typename serialized_index_helper<T, value_type>::type m_index;
+    uint8_t const * m_end;
+  public:
+    serialized_map_view()
+      : m_end(nullptr)
+    {
+    }
+
+    explicit serialized_map_view(uint8_t const * in)
+    {
+      m_end = m_index.scan(in);
+    }
+
+    /*
+      Checked form of the constructor above, as for serialized_vector_view.
+    */
+    serialized_map_view(uint8_t const * begin, uint8_t const * end)
+    {
+      m_end = m_index.scan(begin, end);
+    }
+
+    size_t size() const { return m_index.size(); }
+    bool empty() const { return size() == 0; }
+
+    uint8_t const * data_end() const { return m_end; }
+
+    key_type key(size_t i) const
+    {
+      key_type k;
+      serial_traits<key_type>::deserialize(k, m_index.element(i));
+      return k;
+    }
+
+    mapped_type value(size_t i) const
+    {
+      mapped_type m;
+      serial_traits<mapped_type>::deserialize(m, serial_skip_helper<key_type>::skip(m_index.element(i)));
+      return m;
+    }
+
+    value_type get(size_t i) const
+    {
+      value_type t;
+      serial_traits<value_type>::deserialize(t, m_index.element(i));
+      return t;
+    }
+
+    /*
+      Lookups binary search the encoded entries, which serial_traits<T, 5> writes in key order.
+      Only the probed keys are decoded, so a lookup is O(log n) on a fixed stride map.
+    */
+    const_iterator lower_bound(key_type const & k) const
+    {
+      return const_iterator(this, serialized_lower_bound<typename T::key_compare>(*this, k));
+    }
+
+    const_iterator upper_bound(key_type const & k) const
+    {
+      return const_iterator(this, serialized_upper_bound<typename T::key_compare>(*this, k));
+    }
+
+    const_iterator find(key_type const & k) const
+    {
+      size_t i = serialized_lower_bound<typename T::key_compare>(*this, k);
+      if (i != size() && !typename T::key_compare()(k, key(i))) return const_iterator(this, i);
+      return end();
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+  };
+
+  /*
+    Read-only view of a serialized set-like container (as written by serial_traits<T, 8>, or with an
+    offset index when T is an indexed<C, N>).
+    Lookups binary search the encoded keys, so T must be an ordered set.
+  */
+  template <typename T>
+  class serialized_set_view
+  {
+  public:
+    using key_type = typename T::key_type;
+    using value_type = key_type;
+    using const_iterator = serialized_view_iterator<serialized_set_view>;
+  private:
+    typename serialized_index_helper<T, value_type>::type m_index;
+    uint8_t const * m_end;
+  public:
+    serialized_set_view()
+      : m_end(nullptr)
+    {
+    }
+
+    explicit serialized_set_view(uint8_t const * in)
+    {
+      m_end = m_index.scan(in);
+    }
+
+    /*
+      Checked form of the constructor above, as for serialized_vector_view.
+    */
+    serialized_set_view(uint8_t const * begin, uint8_t const * end)
+    {
+      m_end = m_index.scan(begin, end);
+    }
+
+    size_t size() const { return m_index.size(); }
+    bool empty() const { return size() == 0; }
+
+    uint8_t const * data_end() const { return m_end; }
+
+    key_type key(size_t i) const
+    {
+      key_type k;
+      serial_traits<key_type>::deserialize(k, m_index.element(i));
+      return k;
+    }
+
+    value_type get(size_t i) const { return key(i); }
+
+    const_iterator lower_bound(key_type const & k) const
+    {
+      return const_iterator(this, serialized_lower_bound<typename T::key_compare>(*this, k));
+    }
+
+    const_iterator upper_bound(key_type const & k) const
+    {
+      return const_iterator(this, serialized_upper_bound<typename T::key_compare>(*this, k));
+    }
+
+    const_iterator find(key_type const & k) const
+    {
+      size_t i = serialized_lower_bound<typename T::key_compare>(*this, k);
+      if (i != size() && !typename T::key_compare()(k, key(i))) return const_iterator(this, i);
+      return end();
+    }
+
+    bool contains(key_type const & k) const
+    {
+      return find(k) != end();
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+  };
+
+  template <typename T>
+  class has_serial_size_helper
+  {
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(serial_traits<C>::serial_size(std::declval<C const &>())));
+  public:
+    using type = decltype(test<T>(0));
+  };
+
+  template <typename T>
+  class has_serial_size
+    : public has_serial_size_helper<T>::type
+  {
+  };
+
+  /*
+    Reserves room for serializing in at the end of vec, so the output is written with at most one allocation.
+    Capacity still grows at least geometrically so that many small appends to the same vector stay amortized O(1).
+    Types without serial_size (such as user defined traits that don't provide one) are left alone.
+  */
+  template <typename T, bool B = has_serial_size<T>::value>
+  struct serial_reserve_helper;
+
+  template <typename T>
+  struct serial_reserve_helper<T, false>
+  {
+    template <typename V>
+    static void reserve(T const &, V &)
+    {
+    }
+  };
+
+  template <typename T>
+  struct serial_reserve_helper<T, true>
+  {
+    template <typename V>
+    static void reserve(T const & in, V & vec)
+    {
+      size_t needed = vec.size() + serial_traits<T>::serial_size(in);
+      if (needed > vec.capacity())
+        {
+          vec.reserve(std::max(needed, 2*vec.capacity()));
+        }
+    }
+  };
+
+  template <typename T, typename A>
+  struct serial_helper<T, std::back_insert_iterator<std::vector<uint8_t, A> > >
+  {
+    static inline auto serialize(T const & in, std::back_insert_iterator<std::vector<uint8_t, A> > out) -> std::back_insert_iterator<std::vector<uint8_t, A> >
+    {
+      std::vector<uint8_t, A> & vec = *extract_container(out);
+      serial_reserve_helper<T>::reserve(in, vec);
+      return serial_traits<T>::serialize(in, out);
+    }
+  };
+
+  /*
+    Returns the number of bytes serialize(in, ...) will write.
+  */
+  template <typename T>
+  auto serial_size(T const & in) -> size_t
+  {
+    return serial_traits<T>::serial_size(in);
+  }
+
+  /*
+    Sizes a batch of objects in one pass. The size of each object in [begin, end) is written to sizes,
+    and the total is returned, so a shared buffer can be allocated once before serializing the batch.
+  */
+  template <typename It, typename SizeIt>
+  auto serial_sizes(It begin, It end, SizeIt sizes) -> size_t
+  {
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t total = 0;
+    for (; begin != end; ++begin)
+      {
+        size_t sz = serial_traits<T>::serial_size(*begin);
+        *sizes++ = sz;
+        total += sz;
+      }
+    return total;
+  }
+
+  /*
+    Detects a chunk functor for the chunked serialize() and deserialize() overloads: something callable
+    as f(n) that returns an iterator good for exactly n bytes.
+  */
+  template <typename F>
+  class is_chunk_functor
+  {
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(std::declval<C &>()(size_t())) *);
+  public:
+    static constexpr bool value = decltype(test<typename std::remove_reference<F>::type>(0))::value;
+  };
+
+  template <typename F>
+  struct chunk_functor_iterator
+  {
+    using type = decltype(std::declval<typename std::remove_reference<F>::type &>()(size_t()));
+  };
+
+  template <typename T, bool B = has_serial_size<T>::value>
+  struct serial_size_helper;
+
+  template <typename T>
+  struct serial_size_helper<T, true>
+  {
+    static size_t serial_size(T const & in) { return serial_traits<T>::serial_size(in); }
+  };
+
+  template <typename T>
+  struct serial_size_helper<T, false>
+  {
+    static size_t serial_size(T const & in) { return serial_traits_defaults<T>::serial_size(in); }
+  };
+
+  /*
+    Customization points of the chunked API.
+
+    serial_type_traits<T> gives the serialized size of T: size(t) always, and size() when every T has
+    the same size. serial_iterator_traits<T, It> encodes and decodes T at an iterator that the caller
+    guarantees can hold it, and serial_functor_traits<T, ItF> encodes and decodes T through a chunk
+    functor. The defaults forward to serial_traits<T>. Specializing any of them changes how T is handled
+    by the chunked serialize() and deserialize(), including where T is an element of a container,
+    tuple, optional or variant.
+  */
+  template <typename T, bool B = has_noarg_serial_size<T>::value>
+  struct serial_type_size_helper
+  {
+    static size_t size(T const & t) { return serial_size_helper<T>::serial_size(t); }
+  };
+
+  template <typename T>
+  struct serial_type_size_helper<T, true>
+  {
+    static constexpr size_t size() { return serial_traits<T>::serial_size(); }
+
+    static size_t size(T const &) { return serial_traits<T>::serial_size(); }
+  };
+
+  template <typename T>
+  struct serial_type_traits
+    : public serial_type_size_helper<T>
+  {
+  };
+
+  template <typename T, typename It>
+  struct serial_iterator_traits
+  {
+    static auto serialize_it(It it, T const & t) -> It
+    {
+      return serial_traits<T>::serialize(t, it);
+    }
+
+    static auto deserialize_it(It it, T & t) -> It
+    {
+      return serial_traits<T>::deserialize(t, it);
+    }
+  };
+
+  template <typename T, typename ItF>
+  struct serial_functor_traits;
+
+  template <typename T>
+  class has_fixed_type_size
+  {
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(serial_type_traits<C>::size()) *);
+  public:
+    static constexpr bool value = decltype(test<T>(0))::value;
+  };
+
+  /*
+    Returns the serialized size shared by every T. Only available for types with a fixed serialized size.
+  */
+  template <typename T>
+  constexpr auto serial_size() -> decltype(serial_type_traits<T>::size())
+  {
+    return serial_type_traits<T>::size();
+  }
+
+  /*
+    Chunked serialization.
+
+    Anything whose size is known in O(1) (fixed size types, and containers of fixed size elements) is
+    written with a single f(n) call. Containers of variable size elements request a block for the count,
+    then one per element, and tuples with variable size elements request blocks element by element.
+  */
+  template <typename T, int C = serial_traits_base_cases<T>::base_case()>
+  struct functor_serial_helper
+  {
+    template <typename F>
+    static auto serialize(T const & in, F & f) -> typename chunk_functor_iterator<F>::type
+    {
+      using It = typename chunk_functor_iterator<F>::type;
+      return serial_iterator_traits<T, It>::serialize_it(f(serial_type_traits<T>::size(in)), in);
+    }
+  };
+
+  template <typename T>
+  struct functor_serial_helper<T, 7>
+    : public functor_serial_helper<typename std::remove_reference<T>::type>
+  {
+  };
+
+  template <typename T, typename E>
+  struct functor_container_helper
+  {
+    template <typename F>
+    static auto serialize(T const & in, F & f) -> typename chunk_functor_iterator<F>::type
+    {
+      if (has_fixed_type_size<E>::value)
+        {
+          return functor_serial_helper<T, 0>::serialize(in, f);
+        }
+      auto it = serial_traits<uintany>::serialize(in.size(), f(serial_traits<uintany>::encoded_size(in.size())));
+      for (auto const & x : in)
+        {
+          it = serial_functor_traits<typename std::remove_const<typename std::remove_reference<decltype(x)>::type>::type, F &>::serialize(f, x);
+        }
+      return it;
+    }
+  };
+
+  template <typename T>
+  struct functor_serial_helper<T, 3>
+    : public functor_container_helper<T, typename T::value_type>
+  {
+  };
+
+  template <typename T>
+  struct functor_serial_helper<T, 8>
+    : public functor_container_helper<T, typename T::value_type>
+  {
+  };
+
+  template <typename T>
+  struct functor_serial_helper<T, 5>
+    : public functor_container_helper<T, std::pair<typename T::key_type, typename T::mapped_type>>
+  {
+  };
+
+  template <typename T, size_t I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
+  struct functor_tuple_helper
+  {
+    using E = typename std::remove_const<typename std::remove_reference<typename std::tuple_element<I, T>::type>::type>::type;
+
+    template <typename F>
+    static auto serialize(T const & in, F & f) -> typename chunk_functor_iterator<F>::type
+    {
+      serial_functor_traits<E, F &>::serialize(f, std::get<I>(in));
+      return functor_tuple_helper<T, I+1>::serialize(in, f);
+    }
+
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      serial_functor_traits<E, F &>::deserialize(f, std::get<I>(out));
+      return functor_tuple_helper<T, I+1>::deserialize(f, out);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct functor_tuple_helper<T, I, true>
+  {
+    using E = typename std::remove_const<typename std::remove_reference<typename std::tuple_element<I, T>::type>::type>::type;
+
+    template <typename F>
+    static auto serialize(T const & in, F & f) -> typename chunk_functor_iterator<F>::type
+    {
+      return serial_functor_traits<E, F &>::serialize(f, std::get<I>(in));
+    }
+
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      return serial_functor_traits<E, F &>::deserialize(f, std::get<I>(out));
+    }
+  };
+
+  template <typename T>
+  struct functor_serial_helper<T, 4>
+  {
+    template <typename F>
+    static auto serialize(T const & in, F & f) -> typename chunk_functor_iterator<F>::type
+    {
+      if (has_fixed_type_size<T>::value)
+        {
+          return functor_serial_helper<T, 0>::serialize(in, f);
+        }
+      return functor_tuple_helper<T>::serialize(in, f);
+    }
+  };
+
+  /*
+    Chunked deserialization.
+
+    Fixed size values, including tuples and containers of fixed size elements once their count is
+    known, are read from a single f(n) block. Counts and variant indexes are read a byte at a time,
+    since their length isn't known until their last byte, and are checked like the bounds checked
+    deserialize. Vector-like containers append to out, as the iterator deserialize does, and no
+    container reserves space for a count before the bytes of its elements have been requested. Types
+    of variable size without a chunked reader of their own (user defined traits) read every byte
+    through its own f(1) call.
+  */
+  template <typename F>
+  class chunk_input_iterator
+  {
+    using It = typename chunk_functor_iterator<F>::type;
+
+    F * f;
+    It it;
+    bool loaded;
+
+    void load()
+    {
+      if (!loaded)
+        {
+          it = (*f)(1);
+          loaded = true;
+        }
+    }
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = uint8_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = uint8_t const *;
+    using reference = uint8_t;
+
+    /*
+      Result of post increment, which holds the byte that was current.
+    */
+    class proxy
+    {
+      uint8_t c;
+    public:
+      explicit proxy(uint8_t c_)
+        : c(c_)
+      {
+      }
+
+      uint8_t operator*() const { return c; }
+    };
+
+    explicit chunk_input_iterator(F & f_)
+      : f(&f_), it(), loaded(false)
+    {
+    }
+
+    uint8_t operator*()
+    {
+      load();
+      return uint8_t(*it);
+    }
+
+    chunk_input_iterator & operator++()
+    {
+      load();
+      ++it;
+      loaded = false;
+      return *this;
+    }
+
+    proxy operator++(int)
+    {
+      proxy p(**this);
+      ++*this;
+      return p;
+    }
+
+    /*
+      The iterator from the last f(1) call, advanced past the byte read from it.
+    */
+    It base() const { return it; }
+  };
+
+  /*
+    Reads a uintany count through f, one f(1) block per byte.
+  */
+  template <typename F>
+  auto functor_read_count(F & f, size_t & count) -> typename chunk_functor_iterator<F>::type
+  {
+    constexpr size_t max_bytes = serial_traits<uintany>::encoded_size(UINTMAX_MAX);
+    uint8_t buf[max_bytes];
+    size_t k = 0;
+    auto it = f(1);
+    buf[k++] = uint8_t(*it);
+    ++it;
+    while ((buf[k-1] & 0x80) && k != max_bytes)
+      {
+        it = f(1);
+        buf[k++] = uint8_t(*it);
+        ++it;
+      }
+    uintmax_t n;
+    serial_traits<uintany>::deserialize(n, buf, buf + k);
+    if (n > SIZE_MAX) throw deserialize_error("count out of range");
+    count = size_t(n);
+    return it;
+  }
+
+  /*
+    Requests the block holding count elements of fixed size E.
+  */
+  template <typename E, typename F>
+  auto functor_element_block(F & f, size_t count) -> typename chunk_functor_iterator<F>::type
+  {
+    size_t size = serial_type_traits<E>::size();
+    if (size != 0 && count > SIZE_MAX/size) throw deserialize_error("count out of range");
+    return f(count*size);
+  }
+
+  template <typename T, int C = serial_traits_base_cases<T>::base_case(), bool B = has_fixed_type_size<T>::value>
+  struct functor_deserialize_helper
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      chunk_input_iterator<F> in(f);
+      in = serial_iterator_traits<T, chunk_input_iterator<F>>::deserialize_it(in, out);
+      return in.base();
+    }
+  };
+
+  template <typename T, int C>
+  struct functor_deserialize_helper<T, C, true>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      using It = typename chunk_functor_iterator<F>::type;
+      return serial_iterator_traits<T, It>::deserialize_it(f(serial_type_traits<T>::size()), out);
+    }
+  };
+
+  template <typename T, bool B>
+  struct functor_deserialize_helper<T, 7, B>
+    : public functor_deserialize_helper<typename std::remove_reference<T>::type>
+  {
+  };
+
+  template <typename T, bool B = has_fixed_type_size<typename T::value_type>::value>
+  struct functor_vector_helper;
+
+  template <typename T>
+  struct functor_vector_helper<T, true>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t count, typename chunk_functor_iterator<F>::type it) -> typename chunk_functor_iterator<F>::type
+    {
+      if (count == 0) return it;
+      using It = typename chunk_functor_iterator<F>::type;
+      return vector_deserialize_helper<T, It>::deserialize_elements(out, count, functor_element_block<typename T::value_type>(f, count));
+    }
+  };
+
+  template <typename T>
+  struct functor_vector_helper<T, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t count, typename chunk_functor_iterator<F>::type it) -> typename chunk_functor_iterator<F>::type
+    {
+      using E = typename T::value_type;
+      for (size_t i = 0; i < count; i++)
+        {
+          E e = make_element<E>(out);
+          it = serial_functor_traits<E, F &>::deserialize(f, e);
+          out.push_back(std::move(e));
+        }
+      return it;
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 3, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      size_t count;
+      auto it = functor_read_count(f, count);
+      return functor_vector_helper<T>::deserialize(f, out, count, it);
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 12, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      size_t count;
+      functor_read_count(f, count);
+      return bit_vector_helper<T>::decode(out, count, f(packed_bit_bytes(count)));
+    }
+  };
+
+  template <typename T, typename E, bool B = has_fixed_type_size<E>::value>
+  struct functor_insert_helper;
+
+  template <typename T, typename E>
+  struct functor_insert_helper<T, E, true>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t count, typename chunk_functor_iterator<F>::type it) -> typename chunk_functor_iterator<F>::type
+    {
+      if (count == 0) return it;
+      it = functor_element_block<E>(f, count);
+      for (size_t i = 0; i < count; i++)
+        {
+          it = element_insert_helper<T>::deserialize(out, it);
+        }
+      return it;
+    }
+  };
+
+  template <typename T, typename E>
+  struct functor_insert_helper<T, E, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t count, typename chunk_functor_iterator<F>::type it) -> typename chunk_functor_iterator<F>::type
+    {
+      for (size_t i = 0; i < count; i++)
+        {
+          it = insert(f, out);
+        }
+      return it;
+    }
+
+    template <typename F, typename U = T>
+    static auto insert(F & f, T & out) -> typename std::enable_if<serial_traits_base_cases<U>::base_case() == 8, typename chunk_functor_iterator<F>::type>::type
+    {
+      using V = typename T::value_type;
+      V e = make_element<V>(out);
+      auto it = serial_functor_traits<V, F &>::deserialize(f, e);
+      out.emplace_hint(out.end(), std::move(e));
+      return it;
+    }
+
+    template <typename F, typename U = T>
+    static auto insert(F & f, T & out) -> typename std::enable_if<serial_traits_base_cases<U>::base_case() == 5, typename chunk_functor_iterator<F>::type>::type
+    {
+      using K = typename T::key_type;
+      using V = typename T::mapped_type;
+      K k = make_element<K>(out);
+      serial_functor_traits<K, F &>::deserialize(f, k);
+      V * v = element_insert_helper<T>::emplace(out, k);
+      if (v != nullptr) return serial_functor_traits<V, F &>::deserialize(f, *v);
+      V dup = make_element<V>(out);
+      return serial_functor_traits<V, F &>::deserialize(f, dup);
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 8, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      out.clear();
+      size_t count;
+      auto it = functor_read_count(f, count);
+      return functor_insert_helper<T, typename T::value_type>::deserialize(f, out, count, it);
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 5, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      out.clear();
+      size_t count;
+      auto it = functor_read_count(f, count);
+      return functor_insert_helper<T, std::pair<typename T::key_type, typename T::mapped_type>>::deserialize(f, out, count, it);
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 4, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      return functor_tuple_helper<T>::deserialize(f, out);
+    }
+  };
+
+  template <typename T, size_t I = 0, bool last = (member_list_helper<T>::size-1 == I)>
+  struct functor_member_helper
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      serial_functor_traits<typename member_list_helper<T>::template element<I>, F &>::deserialize(f, member_list_helper<T>::template get<I>(out));
+      return functor_member_helper<T, I+1>::deserialize(f, out);
+    }
+  };
+
+  template <typename T, size_t I>
+  struct functor_member_helper<T, I, true>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      return serial_functor_traits<typename member_list_helper<T>::template element<I>, F &>::deserialize(f, member_list_helper<T>::template get<I>(out));
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 11, false>
+    : public functor_member_helper<T>
+  {
+  };
+
+#if __cplusplus >= 201703L
+  template <typename T>
+  struct functor_deserialize_helper<T, 9, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      using It = typename chunk_functor_iterator<F>::type;
+      uint8_t tag;
+      It it = serial_iterator_traits<uint8_t, It>::deserialize_it(f(1), tag);
+      if (tag == 0)
+        {
+          out.reset();
+          return it;
+        }
+      out.emplace();
+      return serial_functor_traits<typename T::value_type, F &>::deserialize(f, *out);
+    }
+  };
+
+  template <typename T, size_t I = 0, bool last = (std::variant_size<T>::value-1 == I)>
+  struct functor_variant_helper
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t index) -> typename chunk_functor_iterator<F>::type
+    {
+      if (index != I) return functor_variant_helper<T, I+1>::deserialize(f, out, index);
+      return serial_functor_traits<typename std::variant_alternative<I, T>::type, F &>::deserialize(f, out.template emplace<I>());
+    }
+  };
+
+  template <typename T, size_t I>
+  struct functor_variant_helper<T, I, true>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out, size_t index) -> typename chunk_functor_iterator<F>::type
+    {
+      if (index != I) throw deserialize_error("variant index out of range");
+      return serial_functor_traits<typename std::variant_alternative<I, T>::type, F &>::deserialize(f, out.template emplace<I>());
+    }
+  };
+
+  template <typename T>
+  struct functor_deserialize_helper<T, 10, false>
+  {
+    template <typename F>
+    static auto deserialize(F & f, T & out) -> typename chunk_functor_iterator<F>::type
+    {
+      size_t index;
+      functor_read_count(f, index);
+      return functor_variant_helper<T>::deserialize(f, out, index);
+    }
+  };
+#endif
+
+  template <typename T, typename ItF>
+  struct serial_functor_traits
+  {
+    static auto serialize(ItF && f, T const & t) -> typename chunk_functor_iterator<ItF>::type
+    {
+      return functor_serial_helper<T>::serialize(t, f);
+    }
+
+    static auto deserialize(ItF && f, T & t) -> typename chunk_functor_iterator<ItF>::type
+    {
+      return functor_deserialize_helper<T>::deserialize(f, t);
+    }
+  };
+
+  /*
+    Serializes t through the chunk functor f. Each call f(n) must return an output iterator that can
+    accommodate exactly n bytes; bytes are requested in order and each block is filled completely before
+    the next call, so earlier iterators need not remain valid. Returns the iterator returned by the last
+    f(n) call, advanced past the bytes written to it.
+  */
+  template <typename ItF, typename T>
+  auto serialize(ItF && f, T const & t) -> decltype(f(size_t()))
+  {
+    return serial_functor_traits<T, ItF>::serialize(std::forward<ItF>(f), t);
+  }
+
+  /*
+    Deserializes t through the chunk functor f. Each call f(n) must return an input iterator that at
+    least n bytes can be read from, and exactly n are read from it before the next call. f may throw
+    when the input runs out, which leaves t valid but unspecified. Returns the iterator returned by the
+    last f(n) call, advanced past the bytes read from it.
+  */
+  template <typename ItF, typename T>
+  auto deserialize(ItF && f, T & t) -> typename std::enable_if<is_chunk_functor<ItF>::value, decltype(f(size_t()))>::type
+  {
+    return serial_functor_traits<T, ItF>::deserialize(std::forward<ItF>(f), t);
+  }
+
+  /*
+    Serializes t at it, which must be able to accommodate all of its bytes.
+  */
+  template <typename It, typename T>
+  auto serialize_it(It it, T const & t) -> It
+  {
+    return serial_iterator_traits<T, It>::serialize_it(it, t);
+  }
+
+  /*
+    Deserializes t from it without any bounds checks, so it must be known to hold all of its bytes.
+  */
+  template <typename It, typename T>
+  auto deserialize_it(It it, T & t) -> It
+  {
+    return serial_iterator_traits<T, It>::deserialize_it(it, t);
+  }
+
+  template <typename T, typename It>
+  auto serialize(T const & in, It out) -> typename std::enable_if<!is_chunk_functor<T>::value, It>::type
+  {
+    return serial_helper<T, It>::serialize(in, out);
+  }
 
-    }
-  };
 
-  template <typename T>
-  struct serial_traits<T, 8>
+  template <typename T, typename It>
+  auto deserialize(T & out, It in) -> typename std::enable_if<!is_chunk_functor<T>::value, It>::type
   {
-    static void dev_test()  { std::cout << "serial_traits(set)" << std::endl; }
+    return serial_helper<T, It>::deserialize(out, in);
+  }
 
-  private:
+  /*
+    Bounds checked deserialization.
 
-  
+    Fixed size values (including whole tuples and arrays of them) are checked once and then decoded
+    unchecked, as are containers of fixed size elements once their count has been validated against
+    the remaining input. Element counts that could not fit in the remaining input are rejected before
+    anything is reserved. Types that provide deserialize(out, begin, end) in their traits are checked
+    by it, and other user defined traits read through a checked_input_iterator.
+  */
+  class checked_input_iterator
+  {
+    uint8_t const * p;
+    uint8_t const * e;
   public:
-    static size_t serial_size(T const & what)
+    using iterator_category = std::input_iterator_tag;
+    using value_type = uint8_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = uint8_t const *;
+    using reference = uint8_t;
+
+    checked_input_iterator(uint8_t const * p_, uint8_t const * e_)
+      : p(p_), e(e_)
     {
-      size_t sz = serial_traits<uintany>::serial_size(what.size());
-      sz += set_size_helper< T >::serial_size(what);
-      return sz;
     }
-  
-    static constexpr bool serial_size_constexpr() { return false; }
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
-    {
-      out = serial_traits<uintany>::serialize(in.size(), out);
 
-      for (auto it = begin(in); it != end(in); it++)
-        {
-          out = serial_traits<typename T::value_type>::serialize(*it, out);
-        }
-    
-      return out;
+    uint8_t operator*() const
+    {
+      if (p == e) throw deserialize_error("unexpected end of input");
+      return *p;
     }
 
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+    checked_input_iterator & operator++()
     {
-      out.clear();
-      size_t sz = 0;
-      in = serial_traits<uintany>::deserialize(sz, in);
+      p++;
+      return *this;
+    }
 
-      for (size_t i = 0; i < sz; i++)
-        {
-          typename T::value_type iv;
-          in = serial_traits<decltype(iv)>::deserialize(iv, in);
-          out.insert(std::move(iv));
-        }
-      return in;
+    checked_input_iterator operator++(int)
+    {
+      checked_input_iterator t = *this;
+      p++;
+      return t;
     }
-  };
 
+    uint8_t const * base() const { return p; }
 
+    bool operator==(checked_input_iterator const & other) const { return p == other.p; }
+    bool operator!=(checked_input_iterator const & other) const { return p != other.p; }
+  };
 
   template <typename T>
-  struct serial_traits<T, 5>
+  class has_checked_deserialize_helper
   {
-    static void dev_test()  { std::cout << "serial_traits(map)" << std::endl; }
-
-  private:
-
-  
+    template <typename C> static std::false_type test(...);
+    template <typename C> static std::true_type test(decltype(serial_traits<C>::deserialize(std::declval<C &>(), std::declval<uint8_t const *>(), std::declval<uint8_t const *>())) *);
   public:
-    static size_t serial_size(T const & what)
+    using type = decltype(test<T>(0));
+  };
+
+  template <typename T, int C>
+  struct checked_deserialize_helper<T, C, true>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      size_t sz = serial_traits<uintany>::serial_size(what.size());
-      sz += map_size_helper< T >::serial_size(what);
-      return sz;
+      check_remaining(in, end, serial_traits<T>::serial_size());
+      return serial_traits<T>::deserialize(out, in);
     }
-  
-    static constexpr bool serial_size_constexpr() { return false; }
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
-    {
-      out = serial_traits<uintany>::serialize(in.size(), out);
+  };
 
-      for (auto it = begin(in); it != end(in); it++)
-        {
-          out = serial_traits<typename T::value_type>::serialize(*it, out);
-        }
-    
-      return out;
-    }
+  template <typename T, bool B = has_checked_deserialize_helper<T>::type::value>
+  struct checked_user_deserialize_helper;
 
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+  template <typename T>
+  struct checked_user_deserialize_helper<T, true>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      out.clear();
-      size_t sz = 0;
-      in = serial_traits<uintany>::deserialize(sz, in);
+      return serial_traits<T>::deserialize(out, in, end);
+    }
+  };
 
-      for (size_t i = 0; i < sz; i++)
-        {
-          std::pair<typename T::key_type, typename T::mapped_type> iv;
-          in = serial_traits<decltype(iv)>::deserialize(iv, in);
-          out.insert(std::move(iv));
-        }
-      return in;
+  template <typename T>
+  struct checked_user_deserialize_helper<T, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      return serial_traits<T>::deserialize(out, checked_input_iterator(in, end)).base();
     }
   };
 
+  template <typename T>
+  struct checked_deserialize_helper<T, 0, false>
+    : public checked_user_deserialize_helper<T>
+  {
+  };
 
+  template <typename T>
+  struct checked_deserialize_helper<T, 7, false>
+    : public checked_deserialize_helper<typename std::remove_reference<T>::type>
+  {
+  };
 
-  template <typename T, int I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
-  struct tuple_serial_traits;
+  template <typename T, typename E, bool Clear, bool F = has_noarg_serial_size<E>::value>
+  struct checked_container_helper;
 
-  template <typename T, int I>
-  struct tuple_serial_traits<T, I, true>
+  template <typename T, typename E, bool Clear>
+  struct checked_container_helper<T, E, Clear, true>
   {
-    static constexpr bool serial_size_constexpr() 
-    {
-      return serial_traits<typename std::tuple_element<I, T>::type>::serial_size_constexpr;
-    }
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return serial_traits<typename std::tuple_element<I, T>::type>::serialize(std::get<I>(in), out);
+      size_t count;
+      uint8_t const * body = serial_traits<uintany>::deserialize(count, in, end);
+      check_count(body, end, count, serial_traits<E>::serial_size());
+      return serial_traits<T>::deserialize(out, in);
     }
+  };
 
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+  template <typename T, typename E, bool Clear>
+  struct checked_container_helper<T, E, Clear, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return serial_traits<typename std::tuple_element<I, T>::type >::deserialize(std::get<I>(out), in);
+      if (Clear) out.clear();
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      // Every element takes at least one byte.
+      if (count > size_t(end - in)) throw deserialize_error("container count exceeds input");
+      reserve_helper<T>::reserve(out, out.size() + count);
+      for (size_t i = 0; i < count; i++)
+        {
+          E e = make_element<E>(out);
+          in = checked_deserialize_helper<E>::deserialize(e, in, end);
+          out.insert(out.end(), std::move(e));
+        }
+      return in;
     }
   };
 
-
-
-  template <typename T, int I>
-  struct tuple_serial_traits<T, I, false>
+  template <typename T, bool F = has_noarg_serial_size<typename T::value_type>::value>
+  struct checked_vector_helper
+    : public checked_container_helper<T, typename T::value_type, false>
   {
+  };
 
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
-    {
-      out = serial_traits<typename std::tuple_element<I, T>::type>::serialize(std::get<I>(in), out);
-      return tuple_serial_traits<T, I+1>::serialize(in, out);
-    }
-  
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+  template <typename T>
+  struct checked_vector_helper<T, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      in = serial_traits<typename std::tuple_element<I, T>::type>::deserialize(std::get<I>(out), in);
-      return tuple_serial_traits<T, I+1>::deserialize(out, in);
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      // Every element takes at least one byte.
+      if (count > size_t(end - in)) throw deserialize_error("container count exceeds input");
+      return vector_elements_helper<T>::deserialize(out, count, in, end);
     }
-
   };
 
-
   template <typename T>
-  struct serial_traits<T, 4>
+  struct checked_deserialize_helper<T, 3, false>
+    : public checked_vector_helper<T>
   {
-    static void dev_test()  { std::cout << "serial_traits(tuple)" << std::endl; }
+  };
 
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
-    {
-      return tuple_serial_traits<T>::serialize(in, out);
-    }
+  template <typename T, typename E, bool F = has_noarg_serial_size<E>::value>
+  struct checked_associative_helper
+    : public checked_container_helper<T, E, true>
+  {
+  };
 
-    template <typename It>
-    static auto deserialize(T & out, It in) -> It
+  template <typename T, typename E>
+  struct checked_associative_helper<T, E, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return tuple_serial_traits<T>::deserialize(out, in);
+      out.clear();
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      // Every element takes at least one byte.
+      if (count > size_t(end - in)) throw deserialize_error("container count exceeds input");
+      reserve_helper<T>::reserve(out, count);
+      for (size_t i = 0; i < count; i++)
+        {
+          in = element_insert_helper<T>::deserialize(out, in, end);
+        }
+      return in;
     }
-
   };
 
-
   template <typename T>
-  struct serial_traits<T const, 0>
+  struct checked_deserialize_helper<T, 8, false>
+    : public checked_associative_helper<T, typename T::value_type>
   {
-    template <typename It>
-    static auto serialize(T const & in, It out) -> It
-    {
-      return serial_traits<T>::serialize(in, std::move(out));
-    }
   };
 
+  template <typename T>
+  struct checked_deserialize_helper<T, 5, false>
+    : public checked_associative_helper<T, std::pair<typename T::key_type, typename T::mapped_type>>
+  {
+  };
 
-  template <typename T, typename It>
-  struct serial_helper
+  template <typename T, size_t I = 0, bool last = (std::tuple_size<T>::value-1 == I)>
+  struct checked_tuple_helper
   {
-    static auto serialize(T const & in, It out) -> It
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return serial_traits<T>::serialize(in, out);
+      in = checked_deserialize_helper<typename std::tuple_element<I, T>::type>::deserialize(std::get<I>(out), in, end);
+      return checked_tuple_helper<T, I+1>::deserialize(out, in, end);
     }
-    static auto deserialize(T  & out, It in) -> It
+  };
+
+  template <typename T, size_t I>
+  struct checked_tuple_helper<T, I, true>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return serial_traits<T>::deserialize(out, in);
+      return checked_deserialize_helper<typename std::tuple_element<I, T>::type>::deserialize(std::get<I>(out), in, end);
     }
   };
-  
-
-  template <template <typename> typename, typename>
-  class tuple_converter;
 
-  template <template <typename> typename Templ, typename ... Ts>
-  class tuple_converter< Templ,  std::tuple<Ts...> >
+  template <typename T>
+  struct checked_deserialize_helper<T, 4, false>
+    : public checked_tuple_helper<T>
   {
-  public:
-    using type = typename std::tuple<typename Templ<typename std::remove_reference<Ts>::type>::type...>;
   };
 
+  template <typename T>
+  struct checked_deserialize_helper<T, 12, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      size_t count;
+      in = serial_traits<uintany>::deserialize(count, in, end);
+      check_remaining(in, end, packed_bit_bytes(count));
+      return bit_vector_helper<T>::decode(out, count, in);
+    }
+  };
 
   template <typename T>
-  struct tuple_converter_type_helper
+  struct checked_deserialize_helper<T, 11, false>
   {
-    using type = typename serial_traits<T>::async_deserialize;
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
+    {
+      return member_serial_traits<T>::checked_deserialize(out, in, end);
+    }
   };
 
-  template <typename I>
-  struct serial_traits< big_endian<I>, 0 >
+#if __cplusplus >= 201703L
+  template <typename T>
+  struct checked_deserialize_helper<T, 9, false>
   {
-    template <typename It>
-    static auto serialize(I const & num, It out) -> It
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      I copy = num;
-      
-      for (size_t i = 0; i < sizeof(I); i++)
-      {
-        *out = 0xFF & (copy >> ((sizeof(I) - i - 1)*8));
-        ++out;
-      }
-      return out;
+      check_remaining(in, end, 1);
+      if (*in++ == 0)
+        {
+          out.reset();
+          return in;
+        }
+      out.emplace();
+      return checked_deserialize_helper<typename T::value_type>::deserialize(*out, in, end);
     }
-    
-    template <typename It>
-    static auto deserialize(I & out, It in) -> It
+  };
+
+  template <typename T, size_t I = 0, bool last = (std::variant_size<T>::value-1 == I)>
+  struct checked_variant_helper
+  {
+    static uint8_t const * deserialize(T & out, size_t index, uint8_t const * in, uint8_t const * end)
     {
-      I fout = 0;
-      for (size_t i = 0; i < sizeof(I); i++)
-      {
-        fout <<= 8;
-        fout |= static_cast<uint8_t>(*in);
-        ++in;
-      }
-      
-      return in;
+      if (index != I) return checked_variant_helper<T, I+1>::deserialize(out, index, in, end);
+      return checked_deserialize_helper<typename std::variant_alternative<I, T>::type>::deserialize(out.template emplace<I>(), in, end);
     }
-    
-    static size_t serial_size(I const &)
+  };
+
+  template <typename T, size_t I>
+  struct checked_variant_helper<T, I, true>
+  {
+    static uint8_t const * deserialize(T & out, size_t index, uint8_t const * in, uint8_t const * end)
     {
-      return sizeof(I);
+      if (index != I) throw deserialize_error("variant index out of range");
+      return checked_deserialize_helper<typename std::variant_alternative<I, T>::type>::deserialize(out.template emplace<I>(), in, end);
     }
-    
-    static size_t serial_size()
+  };
+
+  template <typename T>
+  struct checked_deserialize_helper<T, 10, false>
+  {
+    static uint8_t const * deserialize(T & out, uint8_t const * in, uint8_t const * end)
     {
-      return sizeof(I);
+      size_t index;
+      in = serial_traits<uintany>::deserialize(index, in, end);
+      return checked_variant_helper<T>::deserialize(out, index, in, end);
     }
   };
+#endif
 
+  template <typename T>
+  auto deserialize(T & out, uint8_t const * begin, uint8_t const * end) -> uint8_t const *
+  {
+    return checked_deserialize_helper<T>::deserialize(out, begin, end);
+  }
 
-  // The following code requires serial_size to actually be implemented for all classes (it's not)
+#if defined(__cpp_lib_memory_resource)
   /*
-    template <typename T, typename A>
-    struct serialize_helper<T, std::back_insert_iterator<std::vector<uint8_t, A> > >
-    {
-    static inline auto serialize(T const & in, std::back_insert_iterator<std::vector<uint8_t, A> > out) -> std::back_insert_iterator<std::vector<uint8_t, A> >
-    {
-    std::vector<uint8_t, A> & vec = *extract_container(out);
-    vec.reserve(vec.size()+serial_traits<T>::serial_size(in));
-    return serial_traits<T>::serialize(in, out);
-    }
-    };
+    Memory resource deserialization.
 
+    deserialize<T>(in, r) decodes and returns a T whose std::pmr containers, and those nested in their
+    elements, all allocate from r. With r a std::pmr::monotonic_buffer_resource, decoding makes no calls
+    to the global allocator once the arena has grown, and the whole value is freed at once by releasing
+    it. A pmr container that is already constructed on r can instead be passed to deserialize(out, in).
   */
-
   template <typename T, typename It>
-  auto serialize(T const & in, It out) -> It
+  T deserialize(It in, std::pmr::memory_resource * r)
   {
-    return serial_helper<T, It>::serialize(in, out);
+    T out = element_allocator_helper<T, std::pmr::polymorphic_allocator<std::byte>>::make(r);
+    deserialize(out, in);
+    return out;
   }
 
-
-  template <typename T, typename It>
-  auto deserialize(T & out, It in) -> It
+  template <typename T>
+  T deserialize(uint8_t const * begin, uint8_t const * end, std::pmr::memory_resource * r)
   {
-    return serial_helper<T, It>::deserialize(out, in);
+    T out = element_allocator_helper<T, std::pmr::polymorphic_allocator<std::byte>>::make(r);
+    deserialize(out, begin, end);
+    return out;
   }
+#endif
   
   
   
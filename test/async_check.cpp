@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Checks the async deserializers of the containers, tuples, optionals and variants: input split at every
+  pair of points decodes to the same value and leaves the bytes of the next value alone, and the
+  more_min()/more_max() hints always bound what is left.
+*/
+
+#include "check.hpp"
+
+#include <array>
+#include <bitset>
+#include <deque>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <variant>
+
+using rpnx_check::encode;
+
+struct quote
+{
+  uint32_t id;
+  uint64_t price;
+  std::string venue;
+
+  bool operator==(quote const & other) const { return id == other.id && price == other.price && venue == other.venue; }
+};
+RPNX_SERIAL_MEMBERS(quote, &quote::id, &quote::price, &quote::venue)
+
+namespace
+{
+  /*
+    Feeds data[0, n) to ds, and checks that it takes exactly the bytes of a value of size total, of
+    which done have already been fed.
+  */
+  template <typename D>
+  bool feed(D & ds, uint8_t const * data, size_t n, size_t done, size_t total)
+  {
+    auto r = ds.insert(data, n);
+    size_t want = total - done < n ? total - done : n;
+    RPNX_CHECK(r.first == want);
+    RPNX_CHECK(r.second == (done + want == total));
+    return r.second;
+  }
+
+  template <typename T>
+  void splits(T const & t)
+  {
+    std::vector<uint8_t> a = encode(t);
+    std::vector<uint8_t> padded(a);
+    padded.push_back(0xaa);
+    padded.push_back(0x01);
+    size_t n = a.size();
+
+    // One split point, and then every pair of them, with the next value's bytes after the last piece.
+    typename rpnx::serial_traits<T>::async_deserializer ds;
+    for (size_t i = 0; i <= n; i++)
+      {
+        for (size_t j = i; j <= n; j++)
+          {
+            if (n > 48 && j != i && j != n) continue;
+            bool done = feed(ds, padded.data(), i, 0, n);
+            if (!done) done = feed(ds, padded.data() + i, j - i, i, n);
+            if (!done) done = feed(ds, padded.data() + j, padded.size() - j, j, n);
+            RPNX_CHECK(done && ds.ready());
+            RPNX_CHECK(ds.get() == t);
+          }
+      }
+
+    // A byte at a time, the hints bound the bytes left and reach zero once the value is ready.
+    for (size_t i = 0; i < n; i++)
+      {
+        RPNX_CHECK(!ds.ready());
+        RPNX_CHECK(ds.more_min() >= 1 || n - i == 0);
+        RPNX_CHECK(ds.more_min() <= n - i && n - i <= ds.more_max());
+        feed(ds, a.data() + i, 1, i, n);
+      }
+    RPNX_CHECK(ds.ready() && ds.more_min() == 0 && ds.more_max() == 0);
+    RPNX_CHECK(ds.get() == t);
+  }
+
+  /*
+    Fixed size values know exactly how many bytes they need before any arrive.
+  */
+  template <typename T>
+  void exact(T const & t)
+  {
+    splits(t);
+    typename rpnx::serial_traits<T>::async_deserializer ds;
+    size_t n = encode(t).size();
+    RPNX_CHECK(ds.more_min() == n && ds.more_max() == n);
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  // Containers, including empty ones and elements of variable size.
+  splits(std::vector<uint32_t>());
+  splits(std::vector<uint32_t>{1, 0xffffffff, 7});
+  splits(std::vector<std::string>{"", "ab", std::string(130, 'c')});
+  splits(std::string("a string"));
+  splits(std::deque<int16_t>{-1, 300, -3});
+  splits(std::list<std::string>{"x", "", "yz"});
+  splits(std::set<uint64_t>{9, 1, uint64_t(1) << 40});
+  splits(std::set<std::string>{"b", "", "a"});
+  splits(std::map<std::string, std::vector<uint16_t>>{{"k", {1, 2}}, {"", {}}, {"long key", {3}}});
+  splits(std::unordered_map<uint32_t, std::string>{{1, "one"}, {2, ""}});
+  splits(std::vector<bool>{true, false, true, true, false, false, true, false, true});
+  splits(std::vector<std::vector<uint8_t>>{{}, {1}, {2, 3}});
+
+  // Tuples, with and without elements of variable size.
+  exact(std::tuple<uint8_t, uint32_t, int64_t>(1, 2, -3));
+  exact(std::array<uint16_t, 3>{{4, 5, 6}});
+  exact(std::pair<uint32_t, uint8_t>(7, 8));
+  exact(std::bitset<70>().set(1).set(68));
+  splits(std::tuple<std::string, uint32_t, std::vector<uint8_t>>("t", 9, {1, 2, 3}));
+  splits(std::pair<std::string, std::string>("", "second"));
+  splits(quote{1, 2, "venue"});
+
+  // Optionals and variants, in every state.
+  splits(std::optional<uint32_t>());
+  splits(std::optional<uint32_t>(5));
+  splits(std::optional<std::string>());
+  splits(std::optional<std::string>("present"));
+  splits(std::variant<uint32_t, std::string, std::vector<uint16_t>>(uint32_t(3)));
+  splits(std::variant<uint32_t, std::string, std::vector<uint16_t>>(std::string("alt")));
+  splits(std::variant<uint32_t, std::string, std::vector<uint16_t>>(std::vector<uint16_t>{1, 2}));
+  splits(std::vector<std::optional<std::variant<uint8_t, std::string>>>{std::nullopt, uint8_t(1), std::string("s")});
+
+  return rpnx_check::check_finish("async_check");
+}
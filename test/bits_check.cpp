@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Checks the packed bit encodings: golden bytes for std::vector<bool> and std::bitset, and round trips
+  through every decoder at lengths on both sides of the 64 bit word the codecs convert at a time.
+*/
+
+#include "check.hpp"
+
+#include <bitset>
+#include <random>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+namespace
+{
+  std::vector<uint8_t> bytes(std::initializer_list<uint8_t> b)
+  {
+    return std::vector<uint8_t>(b);
+  }
+
+  template <typename T>
+  void round_trip(T const & t, size_t bits)
+  {
+    std::vector<uint8_t> a = encode(t);
+    RPNX_CHECK(a.size() == rpnx::serial_size(t));
+
+    // The unused high bits of the last byte are zero.
+    if (bits % 8 != 0) RPNX_CHECK((a.back() >> (bits % 8)) == 0);
+
+    T out{};
+    RPNX_CHECK(rpnx::deserialize(out, a.begin()) == a.end());
+    RPNX_CHECK(out == t);
+
+    T checked{};
+    RPNX_CHECK(rpnx::deserialize(checked, a.data(), a.data() + a.size()) == a.data() + a.size());
+    RPNX_CHECK(checked == t);
+    for (size_t cut = 0; cut < a.size(); cut++)
+      {
+        std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+        T partial{};
+        RPNX_CHECK(rejects([&] { rpnx::deserialize(partial, part.data(), part.data() + part.size()); }));
+      }
+
+    typename rpnx::serial_traits<T>::async_deserializer ds;
+    for (size_t i = 0; i < a.size(); i++)
+      {
+        RPNX_CHECK(ds.insert(a.data() + i, 1).second == (i + 1 == a.size()));
+      }
+    if (!a.empty()) RPNX_CHECK(ds.get() == t);
+  }
+
+  std::vector<bool> pattern(size_t n, int kind, std::mt19937_64 & rng)
+  {
+    std::vector<bool> v(n);
+    for (size_t i = 0; i < n; i++)
+      {
+        v[i] = kind == 0 ? true : kind == 1 ? i % 3 == 1 : bool(rng() & 1);
+      }
+    return v;
+  }
+
+  template <size_t N>
+  void bitset_round_trips(std::mt19937_64 & rng)
+  {
+    for (int kind = 0; kind < 3; kind++)
+      {
+        std::vector<bool> v = pattern(N, kind, rng);
+        std::bitset<N> b;
+        for (size_t i = 0; i < N; i++) b[i] = v[i];
+        round_trip(b, N);
+        round_trip(v, N);
+
+        // The bitset's bytes are the vector's without the count.
+        std::vector<uint8_t> with_count = encode(v);
+        std::vector<uint8_t> without = encode(b);
+        RPNX_CHECK(std::vector<uint8_t>(with_count.end() - without.size(), with_count.end()) == without);
+      }
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  // A uintany bit count, then the bits LSB first: bit i is bit i%8 of byte i/8.
+  RPNX_CHECK(encode(std::vector<bool>()) == bytes({0}));
+  RPNX_CHECK(encode(std::vector<bool>{true}) == bytes({1, 0x01}));
+  RPNX_CHECK(encode(std::vector<bool>{true, false, true, true, false, false, false, false, true}) == bytes({9, 0x0d, 0x01}));
+  RPNX_CHECK(encode(std::vector<bool>(16, true)) == bytes({16, 0xff, 0xff}));
+  std::vector<bool> wide(130);
+  wide[0] = wide[64] = wide[129] = true;
+  // 130 takes two uintany bytes, then bits 0, 64 and 129 land in bytes 0, 8 and 16.
+  std::vector<uint8_t> golden{0x82, 0x00};
+  golden.resize(2 + 17, 0);
+  golden[2 + 0] = 0x01;
+  golden[2 + 8] = 0x01;
+  golden[2 + 16] = 0x02;
+  RPNX_CHECK(encode(wide) == golden);
+
+  // Bitsets are the same bytes without the count, so their size is fixed.
+  RPNX_CHECK(encode(std::bitset<0>()).empty());
+  RPNX_CHECK(encode(std::bitset<3>("101")) == bytes({0x05}));
+  RPNX_CHECK(encode(std::bitset<9>("100000001")) == bytes({0x01, 0x01}));
+  RPNX_CHECK(encode(std::bitset<16>(0xa55a)) == bytes({0x5a, 0xa5}));
+  RPNX_CHECK(encode(std::bitset<64>().set(63)) == bytes({0, 0, 0, 0, 0, 0, 0, 0x80}));
+  RPNX_CHECK(encode(std::bitset<65>().set(0).set(64)) == bytes({0x01, 0, 0, 0, 0, 0, 0, 0, 0x01}));
+  RPNX_CHECK(rpnx::serial_traits<std::bitset<65>>::serial_size() == 9);
+  RPNX_CHECK(rpnx::serial_traits<std::bitset<130>>::serial_size() == 17);
+
+  // Round trips around the 64 bit words.
+  std::mt19937_64 rng(17);
+  round_trip(std::bitset<0>(), 0);
+  round_trip(std::vector<bool>(), 0);
+  bitset_round_trips<1>(rng);
+  bitset_round_trips<63>(rng);
+  bitset_round_trips<64>(rng);
+  bitset_round_trips<65>(rng);
+  bitset_round_trips<127>(rng);
+  bitset_round_trips<128>(rng);
+  bitset_round_trips<130>(rng);
+  for (size_t n : {size_t(7), size_t(8), size_t(200), size_t(1000)})
+    {
+      round_trip(pattern(n, 2, rng), n);
+    }
+
+  // Like the other vector-like containers, decoding appends to what is already there.
+  std::vector<uint8_t> three = encode(std::vector<bool>{true, true, false});
+  std::vector<bool> reused(61, false);
+  rpnx::deserialize(reused, three.begin());
+  std::vector<bool> expect(61, false);
+  expect.insert(expect.end(), {true, true, false});
+  RPNX_CHECK(reused == expect);
+
+  return rpnx_check::check_finish("bits_check");
+}
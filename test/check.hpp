@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Shared helpers for the checks under test/.
+
+  RPNX_CHECK records a failure instead of aborting, so one run reports every broken case, and still
+  checks in release builds where assert() is compiled out. check_rejects(f) expects f() to throw
+  deserialize_error. Every check's main() starts with check_host() and ends with check_finish().
+*/
+
+#ifndef RPNX_SERIAL_CHECK_HH
+#define RPNX_SERIAL_CHECK_HH
+
+#include "rpnx/serial_traits.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#define RPNX_CHECK(...) ((__VA_ARGS__) ? (void)0 : ::rpnx_check::fail(#__VA_ARGS__, __FILE__, __LINE__))
+
+namespace rpnx_check
+{
+  inline int & failures()
+  {
+    static int n = 0;
+    return n;
+  }
+
+  inline void fail(char const * what, char const * file, int line)
+  {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+    failures()++;
+  }
+
+  template <typename F>
+  bool rejects(F && f)
+  {
+    try
+      {
+        f();
+      }
+    catch (rpnx::deserialize_error const &)
+      {
+        return true;
+      }
+    return false;
+  }
+
+  /*
+    Returns the encoding of t.
+  */
+  template <typename T>
+  std::vector<uint8_t> encode(T const & t)
+  {
+    std::vector<uint8_t> out;
+    rpnx::serialize(t, std::back_inserter(out));
+    return out;
+  }
+
+  /*
+    Exits with the skip code when the check was built for instructions the host doesn't have.
+  */
+  inline void check_host()
+  {
+#if defined(__AVX2__) && defined(__GNUC__)
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi2"))
+      {
+        std::puts("skipped: the host lacks AVX2 or BMI2");
+        std::exit(77);
+      }
+#endif
+  }
+
+  inline int check_finish(char const * name)
+  {
+    if (failures() != 0)
+      {
+        std::fprintf(stderr, "%s: %d failures\n", name, failures());
+        return EXIT_FAILURE;
+      }
+#if defined(__AVX2__)
+    std::printf("%s ok (AVX2)\n", name);
+#elif defined(__SSE4_1__)
+    std::printf("%s ok (SSE4.1)\n", name);
+#else
+    std::printf("%s ok (scalar)\n", name);
+#endif
+    return EXIT_SUCCESS;
+  }
+}
+
+#endif
@@ -0,0 +1,208 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Checks the bounds checked deserialize(out, begin, end): every base case round trips, every truncation
+  and oversized count is rejected, and so are overlong varints.
+*/
+
+#include "check.hpp"
+
+#include <bitset>
+#include <deque>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+struct quote
+{
+  uint32_t id;
+  uint64_t price;
+  std::string venue;
+
+  bool operator==(quote const & other) const { return id == other.id && price == other.price && venue == other.venue; }
+};
+RPNX_SERIAL_MEMBERS(quote, &quote::id, &quote::price, &quote::venue)
+
+/*
+  A type with hand written traits and no checked deserialize of its own, which is decoded through
+  checked_input_iterator.
+*/
+struct label
+{
+  std::string text;
+
+  bool operator==(label const & other) const { return text == other.text; }
+};
+
+namespace rpnx
+{
+  template <>
+  struct serial_traits<label>
+  {
+    static size_t serial_size(label const & in) { return serial_traits<std::string>::serial_size(in.text); }
+
+    template <typename It>
+    static It serialize(label const & in, It out) { return serial_traits<std::string>::serialize(in.text, out); }
+
+    template <typename It>
+    static It deserialize(label & out, It in) { return serial_traits<std::string>::deserialize(out.text, in); }
+  };
+}
+
+namespace
+{
+  template <typename T>
+  void round_trip(T const & t)
+  {
+    std::vector<uint8_t> a = encode(t);
+
+    T out{};
+    RPNX_CHECK(rpnx::deserialize(out, a.data(), a.data() + a.size()) == a.data() + a.size());
+    RPNX_CHECK(out == t);
+
+    std::vector<uint8_t> padded(a);
+    padded.push_back(0xff);
+    T more{};
+    RPNX_CHECK(rpnx::deserialize(more, padded.data(), padded.data() + padded.size()) == padded.data() + a.size());
+    RPNX_CHECK(more == t);
+
+    for (size_t cut = 0; cut < a.size(); cut++)
+      {
+        // A copy of just the prefix, so reading past it is also caught by sanitizers.
+        std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+        T partial{};
+        RPNX_CHECK(rejects([&] { rpnx::deserialize(partial, part.data(), part.data() + part.size()); }));
+      }
+  }
+
+  /*
+    Bytes for a uintany count followed by n bytes of filler.
+  */
+  std::vector<uint8_t> count_then(uintmax_t count, size_t n)
+  {
+    std::vector<uint8_t> a;
+    rpnx::serial_traits<rpnx::uintany>::serialize(count, std::back_inserter(a));
+    a.resize(a.size() + n, 1);
+    return a;
+  }
+
+  template <typename T>
+  bool decode_rejects(std::vector<uint8_t> const & a)
+  {
+    T out{};
+    return rejects([&] { rpnx::deserialize(out, a.data(), a.data() + a.size()); });
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  // Integers (1, 2).
+  round_trip(uint8_t(0xab));
+  round_trip(uint64_t(0x0123456789abcdef));
+  round_trip(int16_t(-2));
+  round_trip(int64_t(INT64_MIN));
+
+  // Vector-like (3).
+  round_trip(std::vector<uint32_t>{});
+  round_trip(std::vector<uint32_t>{1, 2, 0xffffffff});
+  round_trip(std::string("checked"));
+  round_trip(std::vector<std::string>{"a", "", "ccc"});
+  round_trip(std::deque<int16_t>{-1, 2, -3});
+  round_trip(std::list<std::string>{"x", "yy"});
+  round_trip(std::vector<std::bitset<0>>(3));
+
+  // Tuples, pairs and arrays (4).
+  round_trip(std::make_tuple(uint8_t(1), std::string("two"), int32_t(-3)));
+  round_trip(std::make_pair(uint16_t(7), std::vector<uint8_t>{1, 2}));
+  round_trip(std::array<uint32_t, 4>{{1, 2, 3, 4}});
+  round_trip(std::array<std::string, 2>{{"a", "bc"}});
+
+  // Maps (5) and sets (8).
+  round_trip(std::map<std::set<uint16_t>, std::string>{{{1, 3, 4}, "hello"}, {{4, 5}, "world"}});
+  round_trip(std::map<uint32_t, uint64_t>{{1, 2}, {3, 4}});
+  round_trip(std::multimap<uint8_t, std::string>{{1, "a"}, {1, "b"}});
+  round_trip(std::unordered_map<std::string, uint32_t>{{"a", 1}, {"b", 2}});
+  round_trip(std::set<uint64_t>{5, 6, 7});
+  round_trip(std::multiset<std::string>{"a", "a", "b"});
+  round_trip(std::unordered_set<uint16_t>{1, 2, 3});
+
+  // Optional (9) and variant (10).
+  round_trip(std::optional<std::string>());
+  round_trip(std::optional<std::string>("present"));
+  round_trip(std::variant<uint32_t, std::string>(uint32_t(9)));
+  round_trip(std::variant<uint32_t, std::string>(std::string("alternative")));
+
+  // Members (11), packed bits (12, 13) and user defined traits (0).
+  round_trip(quote{7, 12345, "X"});
+  round_trip(std::vector<bool>{true, false, true, true, false, false, false, true, true});
+  round_trip(std::bitset<13>(0x1a5a));
+  round_trip(label{"custom"});
+  round_trip(std::vector<label>{{"a"}, {"bb"}});
+
+  // Counts that can't fit in the remaining input.
+  RPNX_CHECK(decode_rejects<std::vector<uint32_t>>(count_then(3, 11)));
+  RPNX_CHECK(decode_rejects<std::vector<uint32_t>>(count_then(uintmax_t(1) << 62, 16)));
+  RPNX_CHECK(decode_rejects<std::string>(count_then(100, 10)));
+  RPNX_CHECK(decode_rejects<std::vector<std::string>>(count_then(uintmax_t(1) << 62, 16)));
+  RPNX_CHECK(decode_rejects<std::deque<uint16_t>>(count_then(UINTMAX_MAX, 16)));
+  RPNX_CHECK(decode_rejects<std::list<uint16_t>>(count_then(UINTMAX_MAX, 16)));
+  RPNX_CHECK(decode_rejects<std::map<uint32_t, std::string>>(count_then(uintmax_t(1) << 40, 16)));
+  RPNX_CHECK(decode_rejects<std::set<uint64_t>>(count_then(5, 39)));
+  RPNX_CHECK(decode_rejects<std::unordered_set<uint64_t>>(count_then(uintmax_t(1) << 40, 16)));
+  RPNX_CHECK(decode_rejects<std::vector<bool>>(count_then(uintmax_t(1) << 60, 16)));
+  RPNX_CHECK(decode_rejects<std::vector<std::bitset<0>>>(count_then(rpnx::max_empty_elements + 1, 0)));
+  RPNX_CHECK(!decode_rejects<std::vector<std::bitset<0>>>(count_then(rpnx::max_empty_elements, 0)));
+
+  // The checked view constructors apply the same count checks.
+  using empty_view = rpnx::serialized_vector_view<std::vector<std::bitset<0>>>;
+  std::vector<uint8_t> empties = encode(std::vector<std::bitset<0>>(3));
+  RPNX_CHECK(empty_view(empties.data(), empties.data() + empties.size()).size() == 3);
+  std::vector<uint8_t> too_many = count_then(rpnx::max_empty_elements + 1, 0);
+  RPNX_CHECK(rejects([&] { empty_view(too_many.data(), too_many.data() + too_many.size()); }));
+  std::vector<uint8_t> short_fixed = count_then(3, 11);
+  RPNX_CHECK(rejects([&] { rpnx::serialized_vector_view<std::vector<uint32_t>>(short_fixed.data(), short_fixed.data() + short_fixed.size()); }));
+
+  // Malformed tags.
+  std::vector<uint8_t> bad_variant = count_then(2, 4);
+  RPNX_CHECK(decode_rejects<std::variant<uint32_t, std::string>>(bad_variant));
+
+  // Overlong varints, as a count and as plain integers.
+  std::vector<uint8_t> eleven(10, 0x80);
+  eleven.push_back(0x00);
+  std::vector<uint8_t> tenth_too_big(9, 0xff);
+  tenth_too_big.push_back(0x02);
+  std::vector<uint8_t> over_max(9, 0xff);
+  over_max.push_back(0x01);
+  for (auto const & a : {eleven, tenth_too_big, over_max})
+    {
+      std::vector<uint8_t> padded(a);
+      padded.resize(a.size() + 32, 0);
+      RPNX_CHECK(decode_rejects<std::vector<uint8_t>>(padded));
+      RPNX_CHECK(decode_rejects<std::string>(padded));
+      uintmax_t u;
+      RPNX_CHECK(rejects([&] { rpnx::serial_traits<rpnx::uintany>::deserialize(u, a.data(), a.data() + a.size()); }));
+      ssize_t s;
+      RPNX_CHECK(rejects([&] { rpnx::serial_traits<rpnx::intany>::deserialize(s, a.data(), a.data() + a.size()); }));
+    }
+
+  return rpnx_check::check_finish("checked_check");
+}
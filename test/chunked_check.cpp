@@ -0,0 +1,287 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Checks the chunked serialize(f, t) and deserialize(f, t): they produce and consume the same bytes as
+  the iterator API for every base case, ask for the blocks they promise, stop with the error f throws
+  when the input runs out, and go through the serial_type_traits, serial_iterator_traits and
+  serial_functor_traits customization points.
+*/
+
+#include "check.hpp"
+
+#include <array>
+#include <bitset>
+#include <deque>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <variant>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+struct quote
+{
+  uint32_t id;
+  uint64_t price;
+  std::string venue;
+
+  bool operator==(quote const & other) const { return id == other.id && price == other.price && venue == other.venue; }
+};
+RPNX_SERIAL_MEMBERS(quote, &quote::id, &quote::price, &quote::venue)
+
+/*
+  A type with hand written traits of variable size and no chunked reader, which is read a byte at a time.
+*/
+struct label
+{
+  std::string text;
+
+  bool operator==(label const & other) const { return text == other.text; }
+};
+
+/*
+  A type whose chunked encoding is customized: it counts the calls and is otherwise a uint32_t.
+*/
+struct tally
+{
+  uint32_t n;
+
+  bool operator==(tally const & other) const { return n == other.n; }
+};
+
+namespace
+{
+  size_t tally_writes = 0;
+  size_t tally_reads = 0;
+}
+
+namespace rpnx
+{
+  template <>
+  struct serial_traits<label>
+  {
+    static size_t serial_size(label const & in) { return serial_traits<std::string>::serial_size(in.text); }
+
+    template <typename It>
+    static It serialize(label const & in, It out) { return serial_traits<std::string>::serialize(in.text, out); }
+
+    template <typename It>
+    static It deserialize(label & out, It in) { return serial_traits<std::string>::deserialize(out.text, in); }
+  };
+
+  template <>
+  struct serial_traits<tally>
+  {
+    static constexpr size_t serial_size() { return 4; }
+    static size_t serial_size(tally const &) { return 4; }
+
+    template <typename It>
+    static It serialize(tally const & in, It out) { return serial_traits<uint32_t>::serialize(in.n, out); }
+
+    template <typename It>
+    static It deserialize(tally & out, It in) { return serial_traits<uint32_t>::deserialize(out.n, in); }
+  };
+
+  template <typename ItF>
+  struct serial_functor_traits<tally, ItF>
+  {
+    static auto serialize(ItF && f, tally const & t) -> typename chunk_functor_iterator<ItF>::type
+    {
+      tally_writes++;
+      return serialize_it(f(4), t.n);
+    }
+
+    static auto deserialize(ItF && f, tally & t) -> typename chunk_functor_iterator<ItF>::type
+    {
+      tally_reads++;
+      return deserialize_it(f(4), t.n);
+    }
+  };
+}
+
+namespace
+{
+  /*
+    Chunk functor over a buffer, which records the sizes asked for and throws once the input runs out.
+  */
+  struct chunk_reader
+  {
+    std::vector<uint8_t> const * buf;
+    size_t pos;
+    std::vector<size_t> sizes;
+
+    uint8_t const * operator()(size_t n)
+    {
+      if (n > buf->size() - pos) throw rpnx::deserialize_error("unexpected end of input");
+      sizes.push_back(n);
+      uint8_t const * p = buf->data() + pos;
+      pos += n;
+      return p;
+    }
+  };
+
+  template <typename T>
+  std::vector<uint8_t> chunked_encode(T const & t, std::vector<size_t> * sizes = nullptr)
+  {
+    std::vector<uint8_t> out;
+    auto last = rpnx::serialize([&](size_t n)
+      {
+        if (sizes) sizes->push_back(n);
+        return std::back_inserter(out);
+      }, t);
+    (void)last;
+    return out;
+  }
+
+  template <typename T>
+  void round_trip(T const & t)
+  {
+    std::vector<uint8_t> a = encode(t);
+    RPNX_CHECK(chunked_encode(t) == a);
+
+    // A pre-sized buffer handed out a block at a time ends exactly at its end.
+    std::vector<uint8_t> slots(a.size());
+    size_t used = 0;
+    uint8_t * end = rpnx::serialize([&](size_t n)
+      {
+        uint8_t * p = slots.data() + used;
+        used += n;
+        return p;
+      }, t);
+    RPNX_CHECK(slots == a && end == slots.data() + slots.size());
+
+    chunk_reader f{&a, 0, {}};
+    T out{};
+    uint8_t const * last = rpnx::deserialize(f, out);
+    RPNX_CHECK(out == t);
+    RPNX_CHECK(f.pos == a.size());
+    RPNX_CHECK(a.empty() || last == a.data() + a.size());
+
+    for (size_t cut = 0; cut < a.size(); cut++)
+      {
+        std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+        chunk_reader g{&part, 0, {}};
+        T partial{};
+        RPNX_CHECK(rejects([&] { rpnx::deserialize(g, partial); }));
+      }
+  }
+
+  template <typename T>
+  std::vector<size_t> read_sizes(T const & t)
+  {
+    std::vector<uint8_t> a = encode(t);
+    chunk_reader f{&a, 0, {}};
+    T out{};
+    rpnx::deserialize(f, out);
+    return f.sizes;
+  }
+
+  template <typename T>
+  bool decode_rejects(std::vector<uint8_t> const & a)
+  {
+    chunk_reader f{&a, 0, {}};
+    T out{};
+    return rejects([&] { rpnx::deserialize(f, out); });
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  // Every base case round trips and matches the iterator encoding.
+  round_trip(uint8_t(7));
+  round_trip(uint64_t(0x0123456789abcdef));
+  round_trip(int32_t(-5));
+  round_trip(std::string());
+  round_trip(std::string("a chunked string body"));
+  round_trip(std::vector<uint32_t>{1, 2, 3, 0xffffffff});
+  round_trip(std::vector<std::string>{"", "x", std::string(300, 'y')});
+  round_trip(std::deque<int16_t>{-1, 2, -3});
+  round_trip(std::list<std::string>{"list", "of", "strings"});
+  round_trip(std::set<uint32_t>{5, 1, 9});
+  round_trip(std::set<std::string>{"b", "a"});
+  round_trip(std::map<uint16_t, uint64_t>{{1, 2}, {3, 4}});
+  round_trip(std::map<std::string, std::vector<uint16_t>>{{"a", {1, 2}}, {"bb", {}}});
+  round_trip(std::unordered_map<uint32_t, std::string>{{1, "one"}});
+  round_trip(std::tuple<uint8_t, std::string, uint32_t>(1, "two", 3));
+  round_trip(std::tuple<uint16_t, uint64_t>(1, 2));
+  round_trip(std::array<uint16_t, 3>{{4, 5, 6}});
+  round_trip(std::optional<std::string>());
+  round_trip(std::optional<std::string>("here"));
+  round_trip(std::variant<uint32_t, std::string>(uint32_t(9)));
+  round_trip(std::variant<uint32_t, std::string>(std::string("alt")));
+  round_trip(std::vector<bool>{true, false, true, true, false, false, true, false, true});
+  round_trip(std::bitset<70>().set(0).set(69));
+  round_trip(quote{7, 1000, "XNAS"});
+  round_trip(std::vector<quote>{{1, 2, "a"}, {3, 4, "bc"}});
+  round_trip(label{"hand written"});
+  round_trip(std::vector<label>{{"x"}, {"yz"}});
+  round_trip(std::vector<uint32_t>(1000, 42));
+
+  // Fixed size values take one block, and so does the body of a string or a vector of integers.
+  RPNX_CHECK(read_sizes(uint64_t(1)) == std::vector<size_t>{8});
+  RPNX_CHECK(read_sizes(std::string(20, 's')) == std::vector<size_t>{1, 20});
+  RPNX_CHECK(read_sizes(std::vector<uint32_t>(200, 1)) == std::vector<size_t>{1, 1, 800});
+  RPNX_CHECK(read_sizes(std::tuple<uint16_t, uint64_t>(1, 2)) == std::vector<size_t>{10});
+  RPNX_CHECK(read_sizes(std::map<uint16_t, uint64_t>{{1, 2}, {3, 4}}) == std::vector<size_t>{1, 20});
+  RPNX_CHECK(read_sizes(std::vector<bool>(20, true)) == std::vector<size_t>{1, 3});
+  RPNX_CHECK(read_sizes(std::optional<uint32_t>(1)) == std::vector<size_t>{1, 4});
+  std::vector<size_t> written;
+  chunked_encode(uint64_t(1), &written);
+  RPNX_CHECK(written == std::vector<size_t>{8});
+  written.clear();
+  chunked_encode(std::vector<std::string>{"ab", "c"}, &written);
+  RPNX_CHECK(written == std::vector<size_t>{1, 3, 2});
+
+  // Vector-like containers append, like the iterator deserialize.
+  std::vector<uint8_t> more = encode(std::vector<uint32_t>{3, 4});
+  chunk_reader f{&more, 0, {}};
+  std::vector<uint32_t> appended{1, 2};
+  rpnx::deserialize(f, appended);
+  RPNX_CHECK(appended == (std::vector<uint32_t>{1, 2, 3, 4}));
+
+  // Malformed input.
+  std::vector<uint8_t> bad_variant{2, 0, 0, 0, 0};
+  RPNX_CHECK(decode_rejects<std::variant<uint32_t, std::string>>(bad_variant));
+  std::vector<uint8_t> overlong(10, 0x80);
+  overlong.push_back(0);
+  RPNX_CHECK(decode_rejects<std::string>(overlong));
+  std::vector<uint8_t> huge;
+  rpnx::serial_traits<rpnx::uintany>::serialize(UINTMAX_MAX/2, std::back_inserter(huge));
+  RPNX_CHECK(decode_rejects<std::vector<uint64_t>>(huge));
+
+  // Customization points.
+  static_assert(rpnx::serial_size<uint64_t>() == 8, "fixed serial size");
+  static_assert(rpnx::serial_type_traits<std::tuple<uint16_t, uint8_t>>::size() == 3, "fixed tuple size");
+  RPNX_CHECK(rpnx::serial_type_traits<std::string>::size(std::string("abc")) == 4);
+  uint8_t word[8];
+  RPNX_CHECK(rpnx::serialize_it(word, uint64_t(0x1122334455667788)) == word + 8);
+  uint64_t back = 0;
+  RPNX_CHECK(rpnx::deserialize_it(static_cast<uint8_t const *>(word), back) == word + 8 && back == 0x1122334455667788);
+  std::vector<tally> tallies{{1}, {2}, {3}};
+  std::vector<uint8_t> t = chunked_encode(tallies);
+  RPNX_CHECK(t == encode(tallies) && tally_writes == 0);
+  std::tuple<tally, std::string> mixed(tally{4}, "s");
+  std::vector<uint8_t> m = chunked_encode(mixed);
+  RPNX_CHECK(m == encode(mixed) && tally_writes == 1);
+  chunk_reader g{&m, 0, {}};
+  std::tuple<tally, std::string> mixed_out;
+  rpnx::deserialize(g, mixed_out);
+  RPNX_CHECK(mixed_out == mixed && tally_reads == 1);
+
+  return rpnx_check::check_finish("chunked_check");
+}
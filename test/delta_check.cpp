@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Checks delta_prefix_sum against a plain loop at every length around the 2 and 4 lane widths of its
+  SSE4.1 and AVX2 paths, and round trips delta_encoded containers at counts around the 256 value
+  blocks the pointer decoder sums at a time, through every decoder.
+*/
+
+#include "check.hpp"
+
+#include <functional>
+#include <random>
+#include <set>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+namespace
+{
+  uintmax_t reference_prefix_sum(std::vector<uintmax_t> & v, uintmax_t carry, bool zigzag)
+  {
+    for (auto & x : v)
+      {
+        carry += zigzag ? rpnx::zigzag_decode(x) : x;
+        x = carry;
+      }
+    return carry;
+  }
+
+  void check_prefix_sum(size_t n, std::mt19937_64 & rng)
+  {
+    for (bool zigzag : {false, true})
+      {
+        for (int pattern = 0; pattern < 3; pattern++)
+          {
+            // Small deltas, full width ones that wrap, and all ones (zigzag -1, or -1 added n times).
+            std::vector<uintmax_t> v(n);
+            for (auto & x : v)
+              {
+                x = pattern == 0 ? rng() % 300 : pattern == 1 ? rng() : UINTMAX_MAX;
+              }
+            uintmax_t carry = pattern == 2 ? 0 : rng();
+
+            std::vector<uintmax_t> expect = v;
+            uintmax_t last = reference_prefix_sum(expect, carry, zigzag);
+
+            // One guard value on each side catches stores outside v[0..n).
+            std::vector<uintmax_t> got(n + 2, 0x5a5a5a5a5a5a5a5a);
+            std::copy(v.begin(), v.end(), got.begin() + 1);
+            RPNX_CHECK(rpnx::delta_prefix_sum(got.data() + 1, n, carry, zigzag) == last);
+            RPNX_CHECK(got.front() == 0x5a5a5a5a5a5a5a5a && got.back() == 0x5a5a5a5a5a5a5a5a);
+            RPNX_CHECK(std::equal(expect.begin(), expect.end(), got.begin() + 1));
+          }
+      }
+  }
+
+  template <typename C>
+  void round_trip(C const & c)
+  {
+    rpnx::delta_encoded<C> const in(c);
+    std::vector<uint8_t> a = encode(in);
+    RPNX_CHECK(a.size() == rpnx::serial_size(in));
+
+    // Pointer input goes through uintany::decode_n and delta_prefix_sum, iterators one value at a time.
+    rpnx::delta_encoded<C> fast;
+    uint8_t const * p = a.data();
+    RPNX_CHECK(rpnx::deserialize(fast, p) == a.data() + a.size());
+    RPNX_CHECK(fast == in);
+
+    rpnx::delta_encoded<C> slow;
+    RPNX_CHECK(rpnx::deserialize(slow, a.begin()) == a.end());
+    RPNX_CHECK(slow == in);
+
+    rpnx::delta_encoded<C> checked;
+    RPNX_CHECK(rpnx::deserialize(checked, a.data(), a.data() + a.size()) == a.data() + a.size());
+    RPNX_CHECK(checked == in);
+    RPNX_CHECK(rejects([&] { rpnx::deserialize(checked, a.data(), a.data() + a.size() - 1); }));
+
+    typename rpnx::serial_traits<rpnx::delta_encoded<C>>::async_deserializer ds;
+    RPNX_CHECK(ds.insert(a.data(), a.size()) == std::make_pair(a.size(), true));
+    RPNX_CHECK(ds.get() == in);
+  }
+
+  /*
+    Round trips n values of V that walk up and down by random steps, as a vector and, deduplicated,
+    as ascending and descending sets.
+  */
+  template <typename V>
+  void round_trips(size_t n, std::mt19937_64 & rng)
+  {
+    std::vector<V> v(n);
+    V x = V(rng());
+    for (auto & e : v)
+      {
+        x = V(x + V(rng() % 2 ? rng() % 1000 : V(0) - V(rng() % 1000)));
+        e = x;
+      }
+    round_trip(v);
+    round_trip(std::set<V>(v.begin(), v.end()));
+    round_trip(std::set<V, std::greater<V>>(v.begin(), v.end()));
+
+    // Extremes, so every difference wraps.
+    std::vector<V> wide(n);
+    for (size_t i = 0; i < n; i++)
+      {
+        wide[i] = i % 2 ? std::numeric_limits<V>::max() : std::numeric_limits<V>::min();
+      }
+    round_trip(wide);
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  std::mt19937_64 rng(18);
+  for (size_t n = 0; n <= 70; n++)
+    {
+      check_prefix_sum(n, rng);
+    }
+  for (size_t n : {size_t(255), size_t(256), size_t(257), size_t(1000)})
+    {
+      check_prefix_sum(n, rng);
+    }
+
+  // Golden bytes: count, the first value, then the differences.
+  RPNX_CHECK(encode(rpnx::delta_encoded<std::vector<uint32_t>>{100, 101, 99}) == (std::vector<uint8_t>{3, 100, 2, 3}));
+  RPNX_CHECK(encode(rpnx::delta_encoded<std::vector<int32_t>>{-1, 0}) == (std::vector<uint8_t>{2, 1, 2}));
+  RPNX_CHECK(encode(rpnx::delta_encoded<std::set<uint32_t>>{5, 6, 10}) == (std::vector<uint8_t>{3, 5, 1, 4}));
+
+  // Counts around the lane widths within a block, and around the block boundaries.
+  for (size_t n : {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 15, 16, 17, 255, 256, 257, 258, 511, 512, 513, 1000})
+    {
+      round_trips<uint64_t>(n, rng);
+      round_trips<int64_t>(n, rng);
+      round_trips<uint32_t>(n, rng);
+      round_trips<int16_t>(n, rng);
+    }
+
+  return rpnx_check::check_finish("delta_check");
+}
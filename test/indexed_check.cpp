@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Checks indexed<C, N>: the count flag and the index are written only past N elements, every decoder
+  (iterator, checked, async) reads both forms, the serialized views reach every element through the
+  index, and plain containers reject indexed bytes.
+*/
+
+#include "check.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+namespace
+{
+  template <typename T>
+  void decodes(std::vector<uint8_t> const & a, T const & expected)
+  {
+    T out;
+    RPNX_CHECK(rpnx::deserialize(out, a.begin()) == a.end());
+    RPNX_CHECK(out == expected);
+
+    T checked;
+    RPNX_CHECK(rpnx::deserialize(checked, a.data(), a.data() + a.size()) == a.data() + a.size());
+    RPNX_CHECK(checked == expected);
+    for (size_t cut = 0; cut < a.size(); cut++)
+      {
+        std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+        T partial;
+        RPNX_CHECK(rejects([&] { rpnx::deserialize(partial, part.data(), part.data() + part.size()); }));
+      }
+
+    // Fed a byte at a time, the async hints bound what is left.
+    typename rpnx::serial_traits<T>::async_deserializer ds;
+    for (size_t i = 0; i < a.size(); i++)
+      {
+        RPNX_CHECK(!ds.ready());
+        RPNX_CHECK(ds.more_min() <= a.size() - i && a.size() - i <= ds.more_max());
+        RPNX_CHECK(ds.insert(a.data() + i, 1) == std::make_pair(size_t(1), i + 1 == a.size()));
+      }
+    RPNX_CHECK(ds.ready() && ds.more_min() == 0 && ds.more_max() == 0);
+    RPNX_CHECK(ds.get() == expected);
+
+    // And in one piece, followed by bytes of the next value that are left alone.
+    std::vector<uint8_t> padded(a);
+    padded.push_back(0x7f);
+    RPNX_CHECK(ds.insert(padded.data(), padded.size()) == std::make_pair(a.size(), true));
+    RPNX_CHECK(ds.get() == expected);
+  }
+
+  template <typename T>
+  bool plain_rejects(std::vector<uint8_t> const & a)
+  {
+    T out;
+    return rejects([&] { rpnx::deserialize(out, a.data(), a.data() + a.size()); });
+  }
+
+  std::vector<uint8_t> bytes(std::initializer_list<uint8_t> b)
+  {
+    return std::vector<uint8_t>(b);
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  // Up to N elements: count*2, then the elements as the plain container writes them.
+  using small_bytes = rpnx::indexed<std::vector<uint8_t>, 4>;
+  RPNX_CHECK(encode(small_bytes()) == bytes({0}));
+  RPNX_CHECK(encode(small_bytes{1, 2, 3}) == bytes({6, 1, 2, 3}));
+  RPNX_CHECK(encode(small_bytes{1, 2, 3, 4}) == bytes({8, 1, 2, 3, 4}));
+
+  // Past N: count*2 + 1, N, the size of the elements, the elements, then the offset deltas of
+  // elements N, 2N ... from the one N before.
+  using tiny_groups = rpnx::indexed<std::vector<uint8_t>, 2>;
+  RPNX_CHECK(encode(tiny_groups{1, 2, 3}) == bytes({7, 2, 3, 1, 2, 3, 2}));
+  RPNX_CHECK(encode(tiny_groups{1, 2, 3, 4, 5}) == bytes({11, 2, 5, 1, 2, 3, 4, 5, 2, 2}));
+  using word_groups = rpnx::indexed<std::vector<std::string>, 2>;
+  RPNX_CHECK(encode(word_groups{"a", "bcd", "", "ef", "g"}) == bytes({11, 2, 12, 1, 'a', 3, 'b', 'c', 'd', 0, 2, 'e', 'f', 1, 'g', 6, 4}));
+  for (auto const & w : {word_groups(), word_groups{"a"}, word_groups{"a", "bcd", "", "ef", "g"}})
+    {
+      RPNX_CHECK(rpnx::serial_size(w) == encode(w).size());
+    }
+
+  // Every decoder, on both sides of N and on the boundary.
+  std::vector<std::string> words;
+  for (size_t i = 0; i < 40; i++) words.push_back(std::string(i % 7, char('a' + i % 26)));
+  for (size_t n : {size_t(0), size_t(1), size_t(7), size_t(8), size_t(9), size_t(17), size_t(40)})
+    {
+      rpnx::indexed<std::vector<std::string>, 8> v(std::vector<std::string>(words.begin(), words.begin() + n));
+      decodes(encode(v), v);
+      rpnx::indexed<std::map<uint32_t, std::string>, 8> m;
+      rpnx::indexed<std::set<std::string>, 8> s;
+      for (size_t i = 0; i < n; i++)
+        {
+          m[uint32_t(i*31)] = words[i];
+          s.insert(words[i] + char('0' + i % 10));
+        }
+      decodes(encode(m), m);
+      decodes(encode(s), s);
+
+      // The views reach every element through the index, with and without checks.
+      std::vector<uint8_t> a = encode(v);
+      rpnx::serialized_vector_view<decltype(v)> view(a.data());
+      rpnx::serialized_vector_view<decltype(v)> checked_view(a.data(), a.data() + a.size());
+      RPNX_CHECK(view.size() == n && checked_view.size() == n);
+      RPNX_CHECK(view.data_end() == a.data() + a.size() && checked_view.data_end() == a.data() + a.size());
+      for (size_t i = 0; i < n; i++)
+        {
+          RPNX_CHECK(view[i] == v[i] && checked_view[i] == v[i]);
+        }
+      std::vector<uint8_t> b = encode(m);
+      rpnx::serialized_map_view<decltype(m)> map_view(b.data(), b.data() + b.size());
+      RPNX_CHECK(map_view.size() == n);
+      for (auto const & kv : m)
+        {
+          RPNX_CHECK(map_view.find(kv.first) != map_view.end() && (*map_view.find(kv.first)).second == kv.second);
+        }
+      RPNX_CHECK(map_view.find(1) == map_view.end());
+      std::vector<uint8_t> c = encode(s);
+      rpnx::serialized_set_view<decltype(s)> set_view(c.data(), c.data() + c.size());
+      for (auto const & k : s)
+        {
+          RPNX_CHECK(set_view.contains(k));
+        }
+      RPNX_CHECK(!set_view.contains("absent"));
+    }
+
+  // Malformed indexes: a zero interval, an element size that disagrees with the elements, and an
+  // offset that doesn't land on an element.
+  std::vector<uint8_t> zero_every = bytes({7, 0, 3, 1, 2, 3, 2});
+  std::vector<uint8_t> short_size = bytes({7, 2, 2, 1, 2, 3, 2});
+  std::vector<uint8_t> bad_offset = bytes({11, 2, 5, 1, 2, 3, 4, 5, 3, 1});
+  for (auto const & a : {zero_every, short_size})
+    {
+      tiny_groups out;
+      RPNX_CHECK(rejects([&] { rpnx::deserialize(out, a.data(), a.data() + a.size()); }));
+      RPNX_CHECK(rejects([&] { rpnx::serialized_vector_view<tiny_groups>(a.data(), a.data() + a.size()); }));
+    }
+  RPNX_CHECK(rejects([&] { rpnx::serialized_vector_view<tiny_groups>(bad_offset.data(), bad_offset.data() + bad_offset.size()); }));
+
+  // Plain containers read the flagged count as a count and reject the bytes.
+  std::vector<uint32_t> numbers{1, 2, 3, 4, 5, 6, 7};
+  for (auto const & a : {encode(rpnx::indexed<std::vector<uint32_t>, 4>(numbers)), encode(rpnx::indexed<std::vector<uint32_t>, 16>(numbers))})
+    {
+      RPNX_CHECK(plain_rejects<std::vector<uint32_t>>(a));
+      RPNX_CHECK(rejects([&] { rpnx::serialized_vector_view<std::vector<uint32_t>>(a.data(), a.data() + a.size()); }));
+    }
+  std::map<uint32_t, uint64_t> pairs{{1, 2}, {3, 4}, {5, 6}};
+  RPNX_CHECK(plain_rejects<std::map<uint32_t, uint64_t>>(encode(rpnx::indexed<std::map<uint32_t, uint64_t>, 2>(pairs))));
+  RPNX_CHECK(plain_rejects<std::map<uint32_t, uint64_t>>(encode(rpnx::indexed<std::map<uint32_t, uint64_t>, 8>(pairs))));
+
+  return rpnx_check::check_finish("indexed_check");
+}
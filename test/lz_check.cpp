@@ -0,0 +1,221 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Checks the compressed streams of serial_lz.hpp: round trips whose values span blocks (including fixed
+  size values split between frames), incompressible input, oversized and corrupt frames, and the async
+  path fed one byte at a time.
+*/
+
+#include "check.hpp"
+
+#include "rpnx/serial_lz.hpp"
+
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+
+using rpnx_check::rejects;
+
+namespace
+{
+  size_t const block_sizes[] = {1, 3, 7, 64, 4096, 65536};
+
+  template <typename T>
+  std::vector<uint8_t> compress(T const & t, size_t block_size)
+  {
+    std::vector<uint8_t> out;
+    rpnx::serialize_compressed(t, std::back_inserter(out), block_size);
+    return out;
+  }
+
+  template <typename T>
+  bool decompresses_to(std::vector<uint8_t> const & in, T const & expected, size_t max_block = rpnx::lz_codec::max_block_size)
+  {
+    T out{};
+    auto end = rpnx::deserialize_compressed(out, in.begin(), max_block);
+    return out == expected && end == in.end();
+  }
+
+  /*
+    Feeds in to an lz_async_input one byte at a time until a T is ready.
+  */
+  template <typename T>
+  bool async_decompresses_to(std::vector<uint8_t> const & in, T const & expected, size_t max_block = rpnx::lz_codec::max_block_size)
+  {
+    rpnx::lz_async_input lz(max_block);
+    typename rpnx::serial_traits<T>::async_deserializer ds;
+    for (size_t i = 0; i < in.size(); i++)
+      {
+        auto r = lz.insert(ds, in.data() + i, 1);
+        if (r.second) return ds.get() == expected;
+      }
+    return false;
+  }
+
+  template <typename T>
+  void check_round_trip(T const & t)
+  {
+    for (size_t block : block_sizes)
+      {
+        std::vector<uint8_t> packed = compress(t, block);
+        RPNX_CHECK(decompresses_to(packed, t));
+        RPNX_CHECK(async_decompresses_to(packed, t));
+      }
+  }
+
+  /*
+    One stored frame holding raw, followed by the end of the stream.
+  */
+  std::vector<uint8_t> stored_stream(std::vector<uint8_t> const & raw)
+  {
+    std::vector<uint8_t> out;
+    rpnx::serial_traits<rpnx::uintany>::serialize(raw.size(), std::back_inserter(out));
+    rpnx::serial_traits<rpnx::uintany>::serialize(raw.size() << 1, std::back_inserter(out));
+    out.insert(out.end(), raw.begin(), raw.end());
+    out.push_back(0);
+    return out;
+  }
+
+  /*
+    One frame with the given header and payload, followed by the end of the stream.
+  */
+  std::vector<uint8_t> frame_stream(size_t raw, size_t tag, std::vector<uint8_t> const & payload)
+  {
+    std::vector<uint8_t> out;
+    rpnx::serial_traits<rpnx::uintany>::serialize(raw, std::back_inserter(out));
+    rpnx::serial_traits<rpnx::uintany>::serialize(tag, std::back_inserter(out));
+    out.insert(out.end(), payload.begin(), payload.end());
+    out.push_back(0);
+    return out;
+  }
+
+  /*
+    Reads in through a checked_input_iterator, so streams cut short throw rather than read past in.
+  */
+  template <typename T>
+  bool decode_rejects(std::vector<uint8_t> const & in, size_t max_block = rpnx::lz_codec::max_block_size)
+  {
+    T out;
+    rpnx::checked_input_iterator first(in.data(), in.data() + in.size());
+    return rejects([&] { rpnx::deserialize_compressed(out, first, max_block); });
+  }
+
+  template <typename T>
+  bool async_rejects(std::vector<uint8_t> const & in, size_t max_block = rpnx::lz_codec::max_block_size)
+  {
+    return rejects([&] { async_decompresses_to(in, T(), max_block); });
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  std::mt19937_64 rng(7);
+
+  // Values that span blocks at every block size, with integers and tuples wider than the smallest blocks.
+  std::vector<uint32_t> counters(3000);
+  for (size_t i = 0; i < counters.size(); i++) counters[i] = uint32_t(i*i % 1000);
+  check_round_trip(counters);
+  std::string text;
+  for (size_t i = 0; i < 5000; i++) text += "lz block "[rng() % 9];
+  check_round_trip(text);
+  std::vector<std::string> words;
+  for (size_t i = 0; i < 300; i++) words.push_back(text.substr(rng() % 4000, rng() % 40));
+  check_round_trip(words);
+  std::map<uint32_t, std::string> named;
+  for (uint32_t i = 0; i < 200; i++) named[i*7919] = words[i];
+  check_round_trip(named);
+  std::vector<std::tuple<uint64_t, uint32_t, std::string>> rows;
+  for (uint32_t i = 0; i < 200; i++) rows.emplace_back(rng(), i, words[i]);
+  check_round_trip(rows);
+  std::deque<uint16_t> samples(2500);
+  for (size_t i = 0; i < samples.size(); i++) samples[i] = uint16_t(i % 300);
+  check_round_trip(samples);
+  check_round_trip(uint64_t(0x0123456789abcdef));
+  check_round_trip(std::vector<uint32_t>());
+  check_round_trip(std::string());
+
+  // Repetitive input shrinks, and incompressible input is stored with only the frame headers added.
+  std::vector<uint8_t> zeros(100000, 0);
+  RPNX_CHECK(compress(zeros, 65536).size() < 1000);
+  std::vector<uint8_t> noise(200000);
+  for (uint8_t & b : noise) b = uint8_t(rng());
+  for (size_t block : {size_t(4096), size_t(65536)})
+    {
+      std::vector<uint8_t> packed = compress(noise, block);
+      size_t frames = (noise.size() + 3)/block + 1;
+      RPNX_CHECK(packed.size() <= noise.size() + 3 + 8*frames + 1);
+      RPNX_CHECK(decompresses_to(packed, noise));
+      RPNX_CHECK(async_decompresses_to(packed, noise));
+    }
+
+  // Frames over the reader's limit are rejected before they are decoded.
+  std::vector<uint8_t> wide = compress(text, 4096);
+  RPNX_CHECK(decompresses_to(wide, text, 4096));
+  RPNX_CHECK(decode_rejects<std::string>(wide, 1024));
+  RPNX_CHECK(async_rejects<std::string>(wide, 1024));
+  RPNX_CHECK(decode_rejects<std::string>(frame_stream(rpnx::lz_codec::max_block_size + 1, 2, {})));
+
+  // Corrupt frames: a stored payload of the wrong size, a compressed payload over the bound, a zero
+  // match offset, and a block that decodes short.
+  std::vector<std::vector<uint8_t>> corrupt = {
+    frame_stream(3, 2 << 1, {1, 2}),
+    frame_stream(4, (rpnx::lz_codec::bound(4) + 1) << 1 | 1, std::vector<uint8_t>(rpnx::lz_codec::bound(4) + 1)),
+    frame_stream(8, 3 << 1 | 1, {0x00, 0x00, 0x00}),
+    frame_stream(8, 4 << 1 | 1, {0x30, 'a', 'b', 'c'}),
+  };
+  for (auto const & c : corrupt)
+    {
+      RPNX_CHECK(decode_rejects<std::string>(c));
+      RPNX_CHECK(async_rejects<std::string>(c));
+    }
+
+  // Every truncation of a valid stream, and trailing data after its end.
+  std::vector<uint8_t> short_stream = compress(words, 64);
+  for (size_t n = 0; n < short_stream.size(); n++)
+    {
+      RPNX_CHECK(decode_rejects<std::vector<std::string>>(std::vector<uint8_t>(short_stream.begin(), short_stream.begin() + n)));
+    }
+  std::vector<uint8_t> trailing = compress(text, 4096);
+  trailing.insert(trailing.end() - 1, {2, 4, 'x', 'y'});
+  RPNX_CHECK(decode_rejects<std::string>(trailing));
+
+  // A bogus count fails at the end of the stream instead of allocating its elements.
+  std::vector<uint8_t> bogus;
+  rpnx::serial_traits<rpnx::uintany>::serialize(uintmax_t(1) << 40, std::back_inserter(bogus));
+  bogus.resize(bogus.size() + 16, 0xab);
+  RPNX_CHECK(decode_rejects<std::vector<uint32_t>>(stored_stream(bogus)));
+  RPNX_CHECK(decode_rejects<std::string>(stored_stream(bogus)));
+
+  // Two values in one stream: the async reader keeps what the first value leaves of a block.
+  std::vector<uint8_t> pair;
+  {
+    rpnx::lz_output<std::back_insert_iterator<std::vector<uint8_t>>> sink(std::back_inserter(pair), 64);
+    rpnx::serialize(words, sink.begin());
+    rpnx::serialize(counters, sink.begin());
+    sink.close();
+  }
+  rpnx::lz_async_input lz;
+  rpnx::serial_traits<std::vector<std::string>>::async_deserializer first;
+  rpnx::serial_traits<std::vector<uint32_t>>::async_deserializer second;
+  size_t i = 0;
+  bool done = false;
+  while (!done && i < pair.size()) done = lz.insert(first, pair.data() + i++, 1).second;
+  RPNX_CHECK(done && first.get() == words);
+  done = lz.insert(second, nullptr, 0).second;
+  while (!done && i < pair.size()) done = lz.insert(second, pair.data() + i++, 1).second;
+  RPNX_CHECK(done && second.get() == counters);
+
+  return rpnx_check::check_finish("lz_check");
+}
@@ -0,0 +1,195 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Checks that the parallel serializer writes exactly what serialize() writes, for every shard plan, and
+  that deserialize_parallel decodes what serialize() wrote, with and without a serial_index, and rejects
+  truncated input and indexes that don't match the data.
+*/
+
+#include "rpnx/serial_parallel.hpp"
+#include "check.hpp"
+
+#include <bitset>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+
+using rpnx_check::encode;
+using rpnx_check::rejects;
+
+namespace
+{
+  template <typename T>
+  void check_serialize(T const & in)
+  {
+    std::vector<uint8_t> expected = encode(in);
+    for (size_t threads : {1, 2, 3, 4, 8})
+      {
+        for (size_t min_shard : {1, 2, 3, 64, 4096})
+          {
+            rpnx::parallel_serializer<T> s(in, threads, min_shard);
+            RPNX_CHECK(s.size() == expected.size());
+            // One spare byte on each side catches writes outside the planned range.
+            std::vector<uint8_t> out(s.size() + 2, 0xa5);
+            RPNX_CHECK(s.write(out.data() + 1) == out.data() + 1 + s.size());
+            RPNX_CHECK(out.front() == 0xa5 && out.back() == 0xa5);
+            RPNX_CHECK(std::equal(expected.begin(), expected.end(), out.begin() + 1));
+          }
+        std::vector<uint8_t> appended = {1, 2, 3};
+        rpnx::serialize_parallel(in, appended, threads);
+        RPNX_CHECK(appended.size() == expected.size() + 3 && std::equal(expected.begin(), expected.end(), appended.begin() + 3));
+        std::vector<uint8_t> raw(expected.size());
+        RPNX_CHECK(rpnx::serialize_parallel(in, raw.data(), threads) == raw.data() + raw.size() && raw == expected);
+      }
+  }
+
+  /*
+    Decodes the encoding of in in parallel, after a sentinel element, and checks it was appended.
+  */
+  template <typename T>
+  void check_deserialize(T const & in, typename T::value_type const & sentinel)
+  {
+    std::vector<uint8_t> a = encode(in);
+    T expected;
+    expected.push_back(sentinel);
+    expected.insert(expected.end(), in.begin(), in.end());
+    for (size_t threads : {1, 2, 4})
+      {
+        T out;
+        out.push_back(sentinel);
+        RPNX_CHECK(rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), threads) == a.data() + a.size());
+        RPNX_CHECK(out == expected);
+      }
+    if (a.size() < 4096)
+      {
+        for (size_t cut = 0; cut < a.size(); cut++)
+          {
+            std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+            T out;
+            RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, part.data(), part.data() + part.size(), 2); }));
+          }
+      }
+  }
+
+  template <typename T>
+  void check_indexed_deserialize(T const & in)
+  {
+    std::vector<uint8_t> a = encode(in);
+    for (size_t every : {1, 3, 64, 100000})
+      {
+        rpnx::serial_index index = rpnx::make_serial_index(in, every);
+        for (size_t threads : {1, 2, 4})
+          {
+            T out;
+            RPNX_CHECK(rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), index, threads) == a.data() + a.size());
+            RPNX_CHECK(out == in);
+          }
+        if (in.empty()) continue;
+
+        std::vector<uint8_t> part(a.begin(), a.end() - 1);
+        T out;
+        RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, part.data(), part.data() + part.size(), index, 2); }));
+
+        // Offsets off by one, at the ends and at a few points in between.
+        size_t groups = index.offsets.size();
+        for (size_t k : {size_t(0), size_t(1), groups/3, groups/2, groups - 2, groups - 1})
+          {
+            if (k >= groups) continue;
+            for (int delta : {-1, 1})
+              {
+                rpnx::serial_index wrong = index;
+                wrong.offsets[k] += delta;
+                T bad;
+                RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(bad, a.data(), a.data() + a.size(), wrong, 2); }));
+              }
+          }
+        rpnx::serial_index shorter = index;
+        shorter.offsets.pop_back();
+        RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), shorter, 2); }));
+        rpnx::serial_index longer = index;
+        longer.offsets.push_back(longer.offsets.back());
+        RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), longer, 2); }));
+        if (in.size() > every)
+          {
+            rpnx::serial_index other = index;
+            other.every = index.every + 1;
+            RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), other, 2); }));
+          }
+      }
+  }
+}
+
+int main()
+{
+  rpnx_check::check_host();
+
+  for (size_t n : {0, 1, 2, 3, 7, 64, 65, 1000, 10007})
+    {
+      std::vector<uint32_t> fixed(n);
+      std::vector<std::string> strings(n);
+      std::vector<std::vector<uint16_t>> nested(n);
+      std::map<uint32_t, std::string> m;
+      std::set<uint64_t> st;
+      std::vector<std::tuple<uint8_t, int64_t>> tuples(n);
+      for (size_t i = 0; i < n; i++)
+        {
+          fixed[i] = uint32_t(i*2654435761u);
+          strings[i] = std::string(i % 37, char('a' + i % 26));
+          nested[i].assign(i % 5, uint16_t(i));
+          m[uint32_t(i*7)] = strings[i];
+          st.insert(uint64_t(i) << (i % 50));
+          tuples[i] = std::make_tuple(uint8_t(i), -int64_t(i));
+        }
+      check_serialize(fixed);
+      check_serialize(strings);
+      check_serialize(nested);
+      check_serialize(m);
+      check_serialize(st);
+      check_serialize(tuples);
+
+      check_deserialize(fixed, 0xdeadbeef);
+      check_deserialize(tuples, std::make_tuple(uint8_t(9), int64_t(9)));
+      check_deserialize(std::vector<std::bitset<0>>(n), std::bitset<0>());
+      check_indexed_deserialize(strings);
+      check_indexed_deserialize(nested);
+
+      std::map<uint32_t, std::string> decoded;
+      std::vector<uint8_t> a = encode(m);
+      RPNX_CHECK(rpnx::deserialize_parallel(decoded, a.data(), a.data() + a.size(), 2) == a.data() + a.size() && decoded == m);
+    }
+
+  // indexed<C, N> carries its own index.
+  rpnx::indexed<std::vector<std::string>, 16> own;
+  for (size_t i = 0; i < 1000; i++) own.push_back(std::to_string(i));
+  std::vector<uint8_t> a = encode(own);
+  for (size_t threads : {1, 2, 4})
+    {
+      rpnx::indexed<std::vector<std::string>, 16> out;
+      RPNX_CHECK(rpnx::deserialize_parallel(out, a.data(), a.data() + a.size(), threads) == a.data() + a.size());
+      RPNX_CHECK(static_cast<std::vector<std::string> const &>(out) == static_cast<std::vector<std::string> const &>(own));
+    }
+  for (size_t cut = 0; cut < a.size(); cut += 7)
+    {
+      std::vector<uint8_t> part(a.begin(), a.begin() + cut);
+      rpnx::indexed<std::vector<std::string>, 16> out;
+      RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(out, part.data(), part.data() + part.size(), 2); }));
+    }
+
+  // A count of zero size elements can't be checked against the input, so it is capped.
+  std::vector<uint8_t> empties;
+  rpnx::serial_traits<rpnx::uintany>::serialize(uintmax_t(1) << 40, std::back_inserter(empties));
+  std::vector<std::bitset<0>> too_many;
+  RPNX_CHECK(rejects([&] { rpnx::deserialize_parallel(too_many, empties.data(), empties.data() + empties.size(), 2); }));
+  check_serialize(std::make_tuple(uint32_t(1), std::string("not a container")));
+
+  return rpnx_check::check_finish("parallel_check");
+}
@@ -0,0 +1,215 @@
+/*
+Copyright (c) 2016, 2017, 2018 Ryan P. Nicholl <exaeta@protonmail.com> http://rpnx.net/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+  Round trip check for serial_traits<uintany>.
+
+  Built once with the default flags and once with the SIMD and BMI2 paths enabled, so both the scalar and
+  vector versions of the encoder and decode_n are checked. Every value is written with serialize and read
+  back with deserialize, the checked deserialize and decode_n, and the encoding is compared with the
+  original loop based encoder for the values it handles.
+*/
+
+#include "rpnx/serial_traits.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace
+{
+  int failures = 0;
+
+  void fail(char const * what, uintmax_t n)
+  {
+    std::fprintf(stderr, "FAIL: %s (value %ju)\n", what, n);
+    failures++;
+  }
+
+  /*
+    The encoder the fast paths replaced. Only defined for values that encode in at most 9 bytes.
+  */
+  std::vector<uint8_t> reference_encode(uintmax_t base)
+  {
+    uintmax_t bytecount = 1;
+    uintmax_t max = (uintmax_t(1) << 7) - 1;
+    while (base > max)
+      {
+        bytecount++;
+        base -= max + 1;
+        max = (uintmax_t(1) << (7*bytecount)) - 1;
+      }
+    std::vector<uint8_t> out;
+    for (uintmax_t i = 0; i < bytecount; i++)
+      {
+        uint8_t val = base & 0x7f;
+        if (i != bytecount - 1) val |= 0x80;
+        out.push_back(val);
+        base >>= 7;
+      }
+    return out;
+  }
+
+  /*
+    First value that takes n+1 bytes.
+  */
+  uintmax_t first_of_length(size_t n)
+  {
+    uintmax_t b = 0;
+    for (size_t k = 1; k <= n; k++) b += uintmax_t(1) << (7*k);
+    return b;
+  }
+
+  size_t expected_length(uintmax_t n)
+  {
+    size_t len = 1;
+    while (len < 10 && n >= first_of_length(len)) len++;
+    return len;
+  }
+
+  void check_value(uintmax_t n)
+  {
+    using traits = rpnx::serial_traits<rpnx::uintany>;
+
+    std::vector<uint8_t> a;
+    traits::serialize(n, std::back_inserter(a));
+    if (a.size() != expected_length(n) || traits::encoded_size(n) != a.size()) fail("encoded length", n);
+    if (a.size() <= 9 && a != reference_encode(n)) fail("encoding differs from the reference encoder", n);
+
+    std::deque<uint8_t> d(a.begin(), a.end());
+    uintmax_t m = 0;
+    if (traits::deserialize(m, d.begin()) != d.end() || m != n) fail("deserialize", n);
+
+    // Exactly sized heap buffers, so sanitizers catch reads past the value.
+    std::vector<uint8_t> exact(a);
+    m = 0;
+    if (traits::deserialize(m, exact.data(), exact.data() + exact.size()) != exact.data() + exact.size() || m != n) fail("checked deserialize", n);
+    for (size_t cut = 0; cut < exact.size(); cut++)
+      {
+        std::vector<uint8_t> part(exact.begin(), exact.begin() + cut);
+        try
+          {
+            traits::deserialize(m, part.data(), part.data() + part.size());
+            fail("checked deserialize accepted a truncated value", n);
+          }
+        catch (rpnx::deserialize_error const &)
+          {
+          }
+      }
+
+    std::vector<uint8_t> padded(a);
+    padded.resize(a.size() + 16, 0xff);
+    m = 0;
+    if (traits::deserialize(m, padded.data(), padded.data() + padded.size()) != padded.data() + a.size() || m != n) fail("checked deserialize with trailing bytes", n);
+
+    m = 0;
+    if (traits::decode_n(exact.data(), 1, &m) != exact.data() + exact.size() || m != n) fail("decode_n of one value", n);
+  }
+
+  /*
+    Encodes values back to back and decodes them with decode_n from an exactly sized buffer.
+  */
+  void check_run(std::vector<uintmax_t> const & values)
+  {
+    std::vector<uint8_t> a;
+    auto it = std::back_inserter(a);
+    for (uintmax_t n : values) it = rpnx::serial_traits<rpnx::uintany>::serialize(n, it);
+    std::vector<uintmax_t> out(values.size());
+    uint8_t const * end = rpnx::serial_traits<rpnx::uintany>::decode_n(a.data(), values.size(), out.data());
+    if (end != a.data() + a.size()) fail("decode_n end of run", values.size());
+    for (size_t i = 0; i < values.size(); i++)
+      {
+        if (out[i] != values[i]) fail("decode_n value in run", values[i]);
+      }
+  }
+
+  void check_rejects(std::vector<uint8_t> const & a, char const * what)
+  {
+    uintmax_t m;
+    try
+      {
+        rpnx::serial_traits<rpnx::uintany>::deserialize(m, a.data(), a.data() + a.size());
+        fail(what, 0);
+      }
+    catch (rpnx::deserialize_error const &)
+      {
+      }
+  }
+}
+
+int main()
+{
+#if defined(__AVX2__) && defined(__GNUC__)
+  if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi2"))
+    {
+      std::puts("skipped: the host lacks AVX2 or BMI2");
+      return 77;
+    }
+#endif
+
+  std::vector<uintmax_t> edges = {0, 1, 127, 128, 129, 255, 256, UINTMAX_MAX - 1, UINTMAX_MAX};
+  for (size_t n = 1; n <= 9; n++)
+    {
+      uintmax_t b = first_of_length(n);
+      edges.push_back(b - 1);
+      edges.push_back(b);
+      edges.push_back(b + 1);
+    }
+  for (size_t k = 0; k < 64; k++)
+    {
+      edges.push_back(uintmax_t(1) << k);
+      edges.push_back((uintmax_t(1) << k) - 1);
+    }
+  for (uintmax_t n : edges) check_value(n);
+
+  std::mt19937_64 rng(42);
+  std::vector<uintmax_t> random;
+  for (size_t i = 0; i < 100000; i++)
+    {
+      uintmax_t n = rng() >> (rng() % 64);
+      check_value(n);
+      random.push_back(n);
+    }
+
+  check_run(edges);
+  check_run(random);
+  for (size_t len = 0; len < 100; len++)
+    {
+      // Runs of single byte values reach the whole block fast path, broken up at every position.
+      std::vector<uintmax_t> run(len, 5);
+      check_run(run);
+      for (size_t i = 0; i < len; i++)
+        {
+          run[i] = edges[(len + i) % edges.size()];
+          check_run(run);
+          run[i] = 5;
+        }
+    }
+
+  check_rejects({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02}, "checked deserialize accepted a tenth byte over 1");
+  check_rejects({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01}, "checked deserialize accepted a value over UINTMAX_MAX");
+  check_rejects({0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00}, "checked deserialize accepted an 11 byte value");
+
+  if (failures != 0)
+    {
+      std::fprintf(stderr, "%d failures\n", failures);
+      return EXIT_FAILURE;
+    }
+#if defined(__AVX2__)
+  std::puts("uintany round trip ok (AVX2)");
+#elif defined(__SSE4_1__)
+  std::puts("uintany round trip ok (SSE4.1)");
+#else
+  std::puts("uintany round trip ok (scalar)");
+#endif
+  return EXIT_SUCCESS;
+}